@@ -9,10 +9,17 @@ void taskMain(timeUs_t currentTimeUs);
 void taskInfo(timeUs_t currentTimeUs);
 void taskBlink(timeUs_t currentTimeUs);
 
+#if defined(USE_SCHEDULER_SNAPSHOT)
+// Short period so a frame goes out in small chunks, decode with extras/tools/snapshot2table.py
+#define INFO_PERIOD TASK_PERIOD_MS(10)
+#else
+#define INFO_PERIOD TASK_PERIOD_MS(2000)
+#endif
+
 task_t tasks[TASK_COUNT] = {
     [TASK_SYSTEM] = DEFINE_TASK("SYSTEM", NULL, taskSystemLoad, TASK_PERIOD_HZ(10), TASK_PRIORITY_MEDIUM_HIGH),
     [TASK_MAIN] = DEFINE_TASK("MAIN", NULL, taskMain, TASK_PERIOD_HZ(1000), TASK_PRIORITY_REALTIME),
-    [TASK_INFO] = DEFINE_TASK("INFO", NULL, taskInfo, TASK_PERIOD_MS(2000), TASK_PRIORITY_LOW),
+    [TASK_INFO] = DEFINE_TASK("INFO", NULL, taskInfo, INFO_PERIOD, TASK_PRIORITY_LOW),
     [TASK_BLINK] = DEFINE_TASK("BLINK", NULL, taskBlink, TASK_PERIOD_HZ(1), TASK_PRIORITY_HIGH),
 };
 
@@ -39,7 +46,16 @@ void taskSystemLoad(timeUs_t currentTimeUs){
 }
 
 void taskInfo(timeUs_t currentTimeUs){
+#if defined(USE_SCHEDULER_SNAPSHOT)
+  static timeUs_t lastSnapshotAtUs;
+  if (cmpTimeUs(currentTimeUs, lastSnapshotAtUs) >= TASK_PERIOD_MS(2000)) {
+    lastSnapshotAtUs = currentTimeUs;
+    scheduler.takeSnapshot();
+  }
+  scheduler.streamSnapshot();
+#else
   scheduler.printTasks();
+#endif
 }
 
 void taskBlink(timeUs_t currentTimeUs){
@@ -0,0 +1,68 @@
+#include "StaticScheduler.h"
+
+
+void taskMain(timeUs_t currentTimeUs);
+void taskInfo(timeUs_t currentTimeUs);
+void taskBlink(timeUs_t currentTimeUs);
+bool checkButton(timeUs_t currentTimeUs, timeDelta_t currentDeltaTimeUs);
+void taskButton(timeUs_t currentTimeUs);
+
+// ids follow the order of the tasks in the scheduler declaration
+enum {
+    STATIC_TASK_MAIN = 0,
+    STATIC_TASK_INFO,
+    STATIC_TASK_BLINK,
+    STATIC_TASK_BUTTON,
+    STATIC_TASK_COUNT
+};
+
+const char * const taskNames[STATIC_TASK_COUNT] = { "MAIN", "INFO", "BLINK", "BUTTON" };
+
+StaticScheduler<true,
+    StaticTask<taskMain, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME>,
+    StaticTask<taskInfo, TASK_PERIOD_MS(2000), TASK_PRIORITY_LOW>,
+    StaticTask<taskBlink, TASK_PERIOD_MS(1000), TASK_PRIORITY_HIGH>,
+    StaticTask<taskButton, TASK_PERIOD_MS(20), TASK_PRIORITY_MEDIUM, checkButton>
+> scheduler(taskNames);
+
+
+void setup() {
+    Serial.begin(115200);
+    pinMode(LED_BUILTIN,OUTPUT);
+    pinMode(2,INPUT);
+    for (int taskId = 0; taskId < STATIC_TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled(taskId, true);
+    }
+}
+
+
+void loop() {
+    scheduler.run_scheduler();
+}
+
+
+void taskInfo(timeUs_t currentTimeUs){
+  char line[64];
+  for (int taskId = 0; taskId < STATIC_TASK_COUNT; taskId++) {
+    taskInfo_t info;
+    scheduler.getTaskInfo(taskId, &info);
+    snprintf(line, sizeof(line), "%-8s max %6lu us avg %6lu us", info.taskName, (unsigned long)info.maxExecutionTimeUs, (unsigned long)info.averageExecutionTimeUs);
+    Serial.println(line);
+    scheduler.schedulerResetTaskMaxExecutionTime(taskId);
+  }
+}
+
+void taskBlink(timeUs_t currentTimeUs){
+  digitalWrite(LED_BUILTIN,!digitalRead(LED_BUILTIN));
+}
+
+bool checkButton(timeUs_t currentTimeUs, timeDelta_t currentDeltaTimeUs){
+  return digitalRead(2) == HIGH;
+}
+
+void taskButton(timeUs_t currentTimeUs){
+  Serial.println("Button pressed");
+}
+
+void taskMain(timeUs_t currentTimeUs){
+}
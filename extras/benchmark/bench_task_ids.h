@@ -0,0 +1,10 @@
+#pragma once
+
+// Task ids for the benchmark builds, BENCH_TASK_COUNT is set by the Makefile
+typedef enum {
+    TASK_MAIN = 0,
+    TASK_COUNT = BENCH_TASK_COUNT,
+    /* Service task IDs */
+    TASK_NONE = TASK_COUNT,
+    TASK_SELF
+} taskId_e;
@@ -0,0 +1,96 @@
+/*
+ * Background runs and realtime lateness with the background tasks run inline
+ * against a HostExecutor with 1, 2 and 4 worker threads. Task 0 is a 1 kHz
+ * realtime task that stays on the scheduler thread, the others spin for a
+ * fixed time on the real clock and together ask for more than one core. The
+ * background runs can only grow with the workers on a host with several CPUs,
+ * the CPU count is printed with the results.
+ * Built with USE_SCHEDULER_TRACE, --trace only runs 4 workers and appends the
+ * trace blob, one track per thread.
+ */
+#include "Scheduler.h"
+#include "HostExecutor.h"
+#include "HostSleep.h"
+#include <new>
+#include <thread>
+
+#define BENCH_DURATION_US 1000000
+#define BENCH_TASK_SPIN_US 50
+
+task_t tasks[TASK_COUNT] = {};
+static uint32_t backgroundRuns;
+
+static void taskMain(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+}
+
+static void taskSpin(timeUs_t currentTimeUs)
+{
+    while (cmpTimeUs(micros(), currentTimeUs) < BENCH_TASK_SPIN_US) {
+    }
+    __atomic_add_fetch(&backgroundRuns, 1, __ATOMIC_RELAXED);
+}
+
+static void runBench(int workerCount, bool trace)
+{
+    new (&tasks[TASK_MAIN]) task_t(DEFINE_TASK("MAIN", NULL, taskMain, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME));
+    for (int taskId = 1; taskId < TASK_COUNT; taskId++) {
+        new (&tasks[taskId]) task_t(DEFINE_TASK("SPIN", NULL, taskSpin, TASK_PERIOD_US(200), TASK_PRIORITY_MEDIUM));
+    }
+    // Start the clock of every task now, so MAIN's first run doesn't count as late
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        tasks[taskId].state.lastExecutedAtUs = tasks[taskId].state.lastDesiredAt = micros();
+    }
+    Scheduler scheduler;
+    HostExecutor *executor = workerCount > 0 ? new HostExecutor(scheduler, workerCount) : NULL;
+    scheduler.setExecutor(executor);
+    scheduler.setSleepFunc(hostSchedulerSleep);
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+    backgroundRuns = 0;
+    const timeUs_t endUs = micros() + BENCH_DURATION_US;
+    while (cmpTimeUs(micros(), endUs) < 0) {
+        scheduler.run_scheduler();
+    }
+    // Let the workers finish what they hold before the table goes away
+    const uint32_t stolenTasks = executor ? executor->getStolenTasks() : 0;
+    delete executor;
+
+    taskInfo_t mainInfo;
+    scheduler.getTaskInfo(TASK_MAIN, &mainInfo);
+    taskHistogramInfo_t mainHistograms;
+    scheduler.getTaskHistogramInfo(TASK_MAIN, &mainHistograms);
+    printf("%-8s %2d workers: %6u background runs/s, MAIN late %4u times, lateness p50 %4u p99 %5u max %5d us",
+           workerCount > 0 ? "executor" : "inline", workerCount, backgroundRuns, mainInfo.realtimeLateCount,
+           mainHistograms.startLateness.p50Us, mainHistograms.startLateness.p99Us, (int)mainInfo.maxRealtimeLatenessUs);
+    if (executor) {
+        printf(", %u stolen", stolenTasks);
+    }
+    printf("\n");
+#if defined(USE_SCHEDULER_TRACE)
+    if (trace) {
+        fflush(stdout);
+        scheduler.dumpTrace();
+    }
+#else
+    (void)trace;
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    const bool trace = argc > 1 && strcmp(argv[1], "--trace") == 0;
+    printf("%d background tasks of %d us every 200 us, one 1 kHz realtime task, %u CPUs\n", (int)TASK_COUNT - 1, BENCH_TASK_SPIN_US,
+           std::thread::hardware_concurrency());
+    if (trace) {
+        runBench(4, true);
+        return 0;
+    }
+    const int workerCounts[] = { 0, 1, 2, 4 };
+    for (unsigned ii = 0; ii < sizeof(workerCounts) / sizeof(workerCounts[0]); ii++) {
+        runBench(workerCounts[ii], false);
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * Wall time split of a loaded scheduler on the system clock, as reported by
+ * getLoadInfo(). Background tasks busy wait for their cost, every eighth one
+ * has a checkFunc that is polled every pass. The first run polls in a busy
+ * loop, the second sleeps through the host tickless hook.
+ */
+#include "Scheduler.h"
+#include "HostSleep.h"
+#include <new>
+
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+#define BENCH_ENGINE "heap"
+#elif defined(USE_SCHEDULER_SPLIT_TASKS)
+#define BENCH_ENGINE "split"
+#else
+#define BENCH_ENGINE "linear"
+#endif
+
+#define BENCH_DURATION_US 1000000
+#define BENCH_TASK_COST_US 20
+#define BENCH_CHECK_TASK_EVERY 8
+
+Scheduler scheduler;
+task_t tasks[TASK_COUNT] = {};
+
+static void spinUs(timeDelta_t durationUs)
+{
+    const timeUs_t startUs = micros();
+    while (cmpTimeUs(micros(), startUs) < durationUs) {
+    }
+}
+
+static void taskMain(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    spinUs(50);
+}
+
+static void taskBody(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    spinUs(BENCH_TASK_COST_US);
+}
+
+static bool checkEveryFifthMs(timeUs_t currentTimeUs, timeDelta_t currentDeltaTimeUs)
+{
+    (void)currentTimeUs;
+    return currentDeltaTimeUs >= 5000;
+}
+
+static void run(bool tickless)
+{
+    scheduler.queueClear();
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+    scheduler.setSleepFunc(tickless ? hostSchedulerSleep : NULL);
+    const timeUs_t startUs = micros();
+    while (cmpTimeUs(micros(), startUs) < BENCH_DURATION_US) {
+        scheduler.run_scheduler();
+    }
+
+    loadInfo_t loadInfo;
+    scheduler.getLoadInfo(&loadInfo);
+    const double windowUs = loadInfo.windowUs > 0 ? loadInfo.windowUs : 1;
+    printf("%-6s %5d %-5s %5u%% %6.1f%% %6.1f%% %6.1f%% %6.1f%% %6.1f%% %6.1f%% %9.2f %10u\n",
+           BENCH_ENGINE, TASK_COUNT, tickless ? "sleep" : "poll", loadInfo.cpuLoadPercent,
+           100.0 * loadInfo.taskUs / windowUs, 100.0 * loadInfo.checkFuncUs / windowUs,
+           100.0 * loadInfo.overheadUs / windowUs, 100.0 * loadInfo.spinUs / windowUs,
+           100.0 * loadInfo.idleUs / windowUs, 100.0 * loadInfo.outsideUs / windowUs,
+           loadInfo.dispatchPasses ? (double)loadInfo.overheadUs / loadInfo.dispatchPasses : 0.0,
+           loadInfo.passes);
+}
+
+int main(int argc, char **argv)
+{
+    new (&tasks[TASK_MAIN]) task_t(DEFINE_TASK("MAIN", NULL, taskMain, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME));
+    for (int taskId = 1; taskId < TASK_COUNT; taskId++) {
+        bool (*checkFunc)(timeUs_t, timeDelta_t) = taskId % BENCH_CHECK_TASK_EVERY == 0 ? checkEveryFifthMs : NULL;
+        new (&tasks[taskId]) task_t(DEFINE_TASK("BG", checkFunc, taskBody, TASK_PERIOD_MS(5 + taskId % 16), TASK_PRIORITY_MEDIUM));
+    }
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+    scheduler.resetTaskStates();
+#endif
+    if (argc > 1 && strcmp(argv[1], "--header") == 0) {
+        printf("%-6s %5s %-5s %6s %7s %7s %7s %7s %7s %7s %9s %10s\n",
+               "engine", "tasks", "idle", "cpu", "task", "check", "sched", "spin", "sleep", "outside", "us/disp", "passes");
+        return 0;
+    }
+    run(false);
+    run(true);
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Cost of Log/Logln to the calling task on the system clock. Built twice by
+ * the Makefile, printing directly and with USE_SCHEDULER_DEFERRED_LOG, where
+ * formatting and sending happen later in logFlush() and are timed apart.
+ * Both builds write the same lines to stdout so "make log" can check the
+ * deferred formatting against vsprintf, the timings go to stderr.
+ *
+ * --tasks prints the task table twice with printTasks() and no flush in
+ * between. The deferred ring drops what doesn't fit, "make log" checks that
+ * every line it does send is a whole line of the direct output.
+ */
+#include "Scheduler.h"
+#include <time.h>
+
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+#define BENCH_LOG "deferred"
+#else
+#define BENCH_LOG "direct"
+#endif
+
+#define BENCH_ROUNDS 20000
+#define BENCH_CALLS_PER_ROUND 6
+
+Scheduler scheduler;
+
+static void taskNop(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+}
+
+task_t tasks[TASK_COUNT] = {
+    [0] = DEFINE_TASK("FUSION", NULL, taskNop, TASK_PERIOD_US(2000), TASK_PRIORITY_REALTIME),
+    [1] = DEFINE_TASK("CONTROL", NULL, taskNop, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME),
+    [2] = DEFINE_TASK("TELEMETRY", NULL, taskNop, TASK_PERIOD_MS(20), TASK_PRIORITY_LOW),
+    [3] = DEFINE_TASK("LOGGER", NULL, taskNop, TASK_PERIOD_MS(5), TASK_PRIORITY_MEDIUM),
+};
+
+static uint64_t monotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// One of each conversion Log/Logln has to carry over to the drain
+static void logRound(int round)
+{
+    scheduler.Logln("round %d of %u, hash 0x%08x %o", round, BENCH_ROUNDS, round * 2654435761u, round);
+    scheduler.Logln("long %ld %lu, long long %lld %llu", -100000L * round, 4000000000UL, -5000000000LL * round, 18000000000000000000ULL);
+    scheduler.Logln("double %f %.9f %e %G", round / 7.0, 1.0 / (round + 1), round * 1e10, round * 1e-10);
+    scheduler.Logln("task %s at %c, width [%*d] [%-*.*f] 100%%", "MAIN", 'A' + round % 26, 6, round, 10, 3, 3.14159);
+    scheduler.Log("no newline %5.1f%%, %hd, ", 99.5, (short)round);
+    scheduler.Logln("then the rest");
+}
+
+// The tasks never run, so both tables hold the same numbers in both builds
+static void printTaskTables(void)
+{
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+    scheduler.printTasks();
+    scheduler.printTasks();
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+    scheduler.logFlush();
+    fflush(stdout);
+    logInfo_t logInfo;
+    scheduler.getLogInfo(&logInfo);
+    fprintf(stderr, "%-8s two printTasks() without a flush, %u records captured, %u dropped, ring high water %u of %d bytes\n",
+            BENCH_LOG, logInfo.capturedRecords, logInfo.droppedRecords, logInfo.maxUsedBytes, SCHEDULER_LOG_BUFFER_SIZE);
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    scheduler.debug(true);
+    if (argc > 1 && strcmp(argv[1], "--tasks") == 0) {
+        printTaskTables();
+        return 0;
+    }
+    uint64_t captureNs = 0;
+    uint64_t drainNs = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t startNs = monotonicNs();
+        logRound(round);
+        captureNs += monotonicNs() - startNs;
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+        startNs = monotonicNs();
+        scheduler.logFlush();
+        drainNs += monotonicNs() - startNs;
+#endif
+    }
+
+    // A port that takes nothing must not hang logFlush(), the line goes out once it moves again
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+    hostSerialStall(true);
+#endif
+    scheduler.Logln("sent after the serial port stalled");
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+    const uint64_t stallStartNs = monotonicNs();
+    const bool stallFlushed = scheduler.logFlush();
+    const uint64_t stallNs = monotonicNs() - stallStartNs;
+    hostSerialStall(false);
+    scheduler.logFlush();
+#endif
+    fflush(stdout);
+
+    const int calls = BENCH_ROUNDS * BENCH_CALLS_PER_ROUND;
+    fprintf(stderr, "%-8s Log/Logln %6.0f ns per call in the task", BENCH_LOG, (double)captureNs / calls);
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+    logInfo_t logInfo;
+    scheduler.getLogInfo(&logInfo);
+    fprintf(stderr, ", formatting and sending %6.0f ns per record later, %u records dropped",
+            (double)drainNs / calls, logInfo.droppedRecords);
+    fprintf(stderr, "\n%-8s logFlush() on a stalled port %s after %.0f ms", BENCH_LOG, stallFlushed ? "returned" : "gave up", stallNs / 1e6);
+#else
+    (void)drainNs;
+#endif
+    fprintf(stderr, "\n");
+    return 0;
+}
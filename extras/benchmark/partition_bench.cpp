@@ -0,0 +1,91 @@
+/*
+ * One scheduler running every task against two schedulers, each owning half
+ * of the tasks on its own thread. Tasks spin for a fixed time on the real
+ * clock, so a saturated scheduler shows how many task runs per second it gets
+ * through. Partition 0 also feeds partition 1 through a SchedulerMailbox. The
+ * partitions can only get through more runs on a host with several CPUs, the
+ * CPU count is printed with the results.
+ */
+#include "Scheduler.h"
+#include "SchedulerMailbox.h"
+#include <new>
+#include <thread>
+
+#define BENCH_DURATION_US 1000000
+#define BENCH_TASK_SPIN_US 20
+#define TASK_CONSUMER ((taskId_e)(TASK_COUNT / 2 - 1))
+
+static task_t singleTable[TASK_COUNT] = {};
+static task_t partitionTables[2][TASK_COUNT / 2] = {};
+static Scheduler partitions[2] = { Scheduler(partitionTables[0], TASK_COUNT / 2), Scheduler(partitionTables[1], TASK_COUNT / 2) };
+static SchedulerMailbox<uint32_t, 64> mailbox(partitions[1], TASK_CONSUMER);
+static uint32_t taskRuns[2];
+static uint32_t itemsSent;
+static uint32_t itemsReceived;
+
+template<int partition> static void taskSpin(timeUs_t currentTimeUs)
+{
+    while (cmpTimeUs(micros(), currentTimeUs) < BENCH_TASK_SPIN_US) {
+    }
+    __atomic_add_fetch(&taskRuns[partition], 1, __ATOMIC_RELAXED);
+}
+
+static void taskProducer(timeUs_t currentTimeUs)
+{
+    taskSpin<0>(currentTimeUs);
+    if (mailbox.push(itemsSent)) {
+        itemsSent++;
+    }
+}
+
+static void taskConsumer(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    uint32_t item;
+    while (mailbox.pop(&item)) {
+        itemsReceived++;
+    }
+}
+
+static void fillTable(task_t *table, int count, void (*taskFunc)(timeUs_t))
+{
+    for (int taskId = 0; taskId < count; taskId++) {
+        new (&table[taskId]) task_t(DEFINE_TASK("SPIN", NULL, taskFunc, TASK_PERIOD_US(100), TASK_PRIORITY_MEDIUM));
+    }
+}
+
+static void runScheduler(Scheduler *scheduler, int count)
+{
+    scheduler->queueClear();
+    for (int taskId = 0; taskId < count; taskId++) {
+        scheduler->setTaskEnabled((taskId_e)taskId, true);
+    }
+    const timeUs_t endUs = micros() + BENCH_DURATION_US;
+    while (cmpTimeUs(micros(), endUs) < 0) {
+        scheduler->run_scheduler();
+    }
+}
+
+int main(void)
+{
+    fillTable(singleTable, TASK_COUNT, taskSpin<0>);
+    Scheduler single(singleTable, TASK_COUNT);
+    runScheduler(&single, TASK_COUNT);
+    const uint32_t singleRuns = taskRuns[0];
+
+    taskRuns[0] = 0;
+    fillTable(partitionTables[0], TASK_COUNT / 2, taskSpin<0>);
+    fillTable(partitionTables[1], TASK_COUNT / 2, taskSpin<1>);
+    new (&partitionTables[0][0]) task_t(DEFINE_TASK("PRODUCER", NULL, taskProducer, TASK_PERIOD_US(100), TASK_PRIORITY_MEDIUM));
+    new (&partitionTables[1][TASK_CONSUMER]) task_t(DEFINE_SIGNAL_TASK("CONSUMER", taskConsumer, TASK_PERIOD_US(100), TASK_PRIORITY_HIGH));
+    std::thread core0(runScheduler, &partitions[0], TASK_COUNT / 2);
+    std::thread core1(runScheduler, &partitions[1], TASK_COUNT / 2);
+    core0.join();
+    core1.join();
+    const uint32_t partitionedRuns = taskRuns[0] + taskRuns[1];
+
+    printf("%d tasks on %u CPUs, one scheduler: %u runs/s, two partitions: %u runs/s\n", (int)TASK_COUNT,
+           std::thread::hardware_concurrency(), singleRuns, partitionedRuns);
+    printf("mailbox: %u sent, %u received, %u dropped\n", itemsSent, itemsReceived + mailbox.count(), mailbox.getDroppedItems());
+    return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * Cost of runtime pool tasks: scheduleOnce() followed by cancel(), as a
+ * protocol stack does with a timeout that is answered in time, and the
+ * scheduler pass with the pool half full of pending timeouts.
+ */
+#include "Scheduler.h"
+#include "HostClock.h"
+#include <time.h>
+
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+#define BENCH_ENGINE "heap"
+#elif defined(USE_SCHEDULER_SPLIT_TASKS)
+#define BENCH_ENGINE "split"
+#else
+#define BENCH_ENGINE "linear"
+#endif
+
+#define BENCH_ROUNDS 1000000
+
+Scheduler scheduler;
+task_t tasks[TASK_COUNT] = {};
+
+static void taskTimeout(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+}
+
+static uint64_t monotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(void)
+{
+    hostClockUseVirtual(true);
+    scheduler.queueClear();
+
+    // Half the pool holds timeouts that never expire during the run
+    for (int ii = 0; ii < SCHEDULER_TASK_POOL_SIZE / 2; ii++) {
+        scheduler.scheduleOnce(taskTimeout, TASK_PERIOD_MS(1000) + ii * TASK_PERIOD_MS(10));
+    }
+
+    uint64_t startNs = monotonicNs();
+    for (int ii = 0; ii < BENCH_ROUNDS; ii++) {
+        scheduler.cancel(scheduler.scheduleOnce(taskTimeout, TASK_PERIOD_MS(50)));
+    }
+    const double scheduleCancelNs = (double)(monotonicNs() - startNs) / BENCH_ROUNDS;
+
+    startNs = monotonicNs();
+    for (int ii = 0; ii < BENCH_ROUNDS; ii++) {
+        scheduler.run_scheduler();
+        hostClockAdvanceUs(1);
+    }
+    const double passNs = (double)(monotonicNs() - startNs) / BENCH_ROUNDS;
+
+    printf("%-7s pool %3d, %3d pending: schedule+cancel %7.1f ns, pass %7.1f ns\n", BENCH_ENGINE,
+           SCHEDULER_TASK_POOL_SIZE, SCHEDULER_TASK_POOL_SIZE / 2, scheduleCancelNs, passNs);
+    return 0;
+}
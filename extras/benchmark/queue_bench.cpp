@@ -0,0 +1,126 @@
+/*
+ * Measures the cost of Scheduler::run_scheduler() itself. Every task body is
+ * empty, so the time spent per pass is the time spent deciding what to run.
+ *
+ * Two workloads are replayed for a fixed wall time:
+ *   idle   - background tasks are due once per second, almost every pass finds nothing to do
+ *   loaded - background tasks are due every 1..16 ms, most passes dispatch a task
+ *
+ * The last columns are the RAM taken by the task table and the scheduler, and
+ * the part of the task table that can be const: with the split layout it only
+ * holds the configuration, so firmware keeps it in flash. The bench builds it
+ * at run time all the same.
+ */
+#include "Scheduler.h"
+#include <new>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+#define BENCH_ENGINE "heap"
+#elif defined(USE_SCHEDULER_SPLIT_TASKS)
+#define BENCH_ENGINE "split"
+#else
+#define BENCH_ENGINE "linear"
+#endif
+
+#define BENCH_DURATION_NS   500000000ULL
+#define BENCH_EVENT_TASK_EVERY 8     // every 8th background task is event driven
+
+Scheduler scheduler;
+task_t tasks[TASK_COUNT] = {};
+
+static uint32_t dispatchedTasks;
+
+static void taskBody(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    dispatchedTasks++;
+}
+
+static void taskMain(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+}
+
+static bool checkNever(timeUs_t currentTimeUs, timeDelta_t currentDeltaTimeUs)
+{
+    (void)currentTimeUs;
+    (void)currentDeltaTimeUs;
+    return false;
+}
+
+static uint64_t monotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void setupTasks(timeDelta_t basePeriodUs, bool spreadPeriods)
+{
+    // task_t has const members, so rebuild every entry in place
+    new (&tasks[TASK_MAIN]) task_t(DEFINE_TASK("MAIN", NULL, taskMain, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME));
+    for (int taskId = 1; taskId < TASK_COUNT; taskId++) {
+        const timeDelta_t periodUs = spreadPeriods ? basePeriodUs * (1 + taskId % 16) : basePeriodUs;
+        const bool eventDriven = taskId % BENCH_EVENT_TASK_EVERY == 0;
+        new (&tasks[taskId]) task_t(DEFINE_TASK("BENCH", eventDriven ? checkNever : NULL, taskBody, periodUs, (int8_t)(1 + taskId % TASK_PRIORITY_HIGH)));
+    }
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+    scheduler.resetTaskStates();
+#endif
+    scheduler.queueClear();
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+}
+
+static void runWorkload(const char *name, timeDelta_t basePeriodUs, bool spreadPeriods)
+{
+    setupTasks(basePeriodUs, spreadPeriods);
+    dispatchedTasks = 0;
+
+    // Let the initial burst of overdue tasks drain before measuring
+    const uint64_t warmupEndNs = monotonicNs() + BENCH_DURATION_NS / 10;
+    while (monotonicNs() < warmupEndNs) {
+        scheduler.run_scheduler();
+    }
+
+    dispatchedTasks = 0;
+    uint64_t passes = 0;
+    uint64_t busyNs = 0;
+    uint64_t maxPassNs = 0;
+    const uint64_t endNs = monotonicNs() + BENCH_DURATION_NS;
+    for (uint64_t nowNs = monotonicNs(); nowNs < endNs; passes++) {
+        scheduler.run_scheduler();
+        const uint64_t afterNs = monotonicNs();
+        const uint64_t passNs = afterNs - nowNs;
+        busyNs += passNs;
+        if (passNs > maxPassNs) {
+            maxPassNs = passNs;
+        }
+        nowNs = afterNs;
+    }
+
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+    const unsigned ramBytes = sizeof(scheduler);
+    const unsigned constBytes = sizeof(tasks);
+#else
+    const unsigned ramBytes = sizeof(tasks) + sizeof(scheduler);
+    const unsigned constBytes = 0;
+#endif
+    printf("%-7s %4d  %-7s %10.1f %10llu %12llu %10u %8u %8u\n", BENCH_ENGINE, (int)TASK_COUNT, name,
+           (double)busyNs / passes, (unsigned long long)maxPassNs, (unsigned long long)passes, dispatchedTasks,
+           ramBytes, constBytes);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--header") == 0) {
+        printf("%-7s %4s  %-7s %10s %10s %12s %10s %8s %8s\n", "engine", "n", "load", "ns/pass", "max ns", "passes", "dispatched", "RAM", "const");
+        return 0;
+    }
+    runWorkload("idle", TASK_PERIOD_MS(1000), false);
+    runWorkload("loaded", TASK_PERIOD_MS(1), true);
+    return 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * A 1 kHz control loop running in the background next to slow tasks that
+ * often start it late, on the virtual clock. By default the loop is due a
+ * period after its last start, --anchored keeps it on a fixed grid and
+ * --catch-up additionally runs up to two missed releases back to back.
+ */
+#include "Scheduler.h"
+#include "Simulation.h"
+
+#define TASK_LOGGER 1
+#define TASK_LINK 2
+#define SIM_DURATION_US (10 * 1000000)
+
+Scheduler scheduler;
+
+static void taskNop(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+}
+
+task_t tasks[TASK_COUNT] = {
+    [TASK_MAIN] = DEFINE_TASK("CONTROL", NULL, taskNop, TASK_PERIOD_US(1000), TASK_PRIORITY_HIGH),
+    [TASK_LOGGER] = DEFINE_TASK("LOGGER", NULL, taskNop, TASK_PERIOD_US(3000), TASK_PRIORITY_MEDIUM),
+    [TASK_LINK] = DEFINE_TASK("LINK", NULL, taskNop, TASK_PERIOD_US(7000), TASK_PRIORITY_LOW),
+};
+
+int main(int argc, char **argv)
+{
+    taskTiming_e timing = TASK_TIMING_RELATIVE;
+    const char *title = "control loop, relative timing";
+    if (argc > 1 && strcmp(argv[1], "--anchored") == 0) {
+        timing = TASK_TIMING_ANCHORED;
+        title = "control loop, anchored, missed releases skipped";
+    } else if (argc > 1 && strcmp(argv[1], "--catch-up") == 0) {
+        timing = TASK_TIMING_CATCH_UP;
+        title = "control loop, anchored, up to 2 missed releases caught up";
+    }
+
+    Simulation simulation(scheduler, tasks, TASK_COUNT);
+    simulation.setPassCostUs(10);
+    simulation.setTaskModel(TASK_MAIN, 150, 50);
+    simulation.setTaskModel(TASK_LOGGER, 400, 400);
+    simulation.setTaskModel(TASK_LINK, 900, 600);
+
+    scheduler.queueClear();
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+    scheduler.setTaskTiming(TASK_MAIN, timing, 2);
+    simulation.run(SIM_DURATION_US);
+    simulation.report(title);
+
+    taskInfo_t taskInfo;
+    scheduler.getTaskInfo(TASK_MAIN, &taskInfo);
+    printf("CONTROL: %u runs for %u releases, %u missed, %.1f ms accumulated drift\n",
+           simulation.getTaskResult(TASK_MAIN)->runs, (unsigned)(SIM_DURATION_US / 1000),
+           (unsigned)taskInfo.missedReleases, taskInfo.accumulatedDriftUs / 1000.0);
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * A sample -> filter -> publish pipeline next to a 1 kHz realtime task and a
+ * slow background task, on the virtual clock. --polled hands the stages over
+ * through flags polled by checkFuncs, the default links them with
+ * addTaskSuccessor() so each stage is signalled when the previous one returns.
+ */
+#include "Scheduler.h"
+#include "HostClock.h"
+#include <new>
+
+#define TASK_SAMPLE 1
+#define TASK_FILTER 2
+#define TASK_PUBLISH 3
+#define TASK_LOGGER 4
+#define SIM_DURATION_US (10 * 1000000)
+#define SIM_PASS_COST_US 10
+#define SIM_CHECK_COST_US 2
+
+Scheduler scheduler;
+task_t tasks[TASK_COUNT] = {};
+
+static bool chained;
+static bool sampleReady;
+static bool filterReady;
+static uint32_t sampleCount;
+static timeUs_t sampleStartedAtUs;
+static uint32_t publishedCount;
+static uint32_t payloadErrors;
+static int64_t sumPipelineLatencyUs;
+static timeDelta_t maxPipelineLatencyUs;
+
+static void taskControl(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    hostClockAdvanceUs(150);
+}
+
+static void taskLogger(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    hostClockAdvanceUs(300);
+}
+
+static void taskSample(timeUs_t currentTimeUs)
+{
+    sampleStartedAtUs = currentTimeUs;
+    hostClockAdvanceUs(50);
+    sampleCount++;
+    if (chained) {
+        scheduler.setTaskOutput(sampleCount);
+    } else {
+        sampleReady = true;
+    }
+}
+
+static bool checkSample(timeUs_t currentTimeUs, timeDelta_t currentDeltaTimeUs)
+{
+    (void)currentTimeUs;
+    (void)currentDeltaTimeUs;
+    hostClockAdvanceUs(SIM_CHECK_COST_US);
+    return sampleReady;
+}
+
+static void taskFilter(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    hostClockAdvanceUs(80);
+    if (chained) {
+        scheduler.setTaskOutput(scheduler.getTaskInput());
+    } else {
+        sampleReady = false;
+        filterReady = true;
+    }
+}
+
+static bool checkFilter(timeUs_t currentTimeUs, timeDelta_t currentDeltaTimeUs)
+{
+    (void)currentTimeUs;
+    (void)currentDeltaTimeUs;
+    hostClockAdvanceUs(SIM_CHECK_COST_US);
+    return filterReady;
+}
+
+static void taskPublish(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    hostClockAdvanceUs(40);
+    if (chained) {
+        payloadErrors += scheduler.getTaskInput() != sampleCount;
+    } else {
+        filterReady = false;
+    }
+    const timeDelta_t latencyUs = cmpTimeUs(micros(), sampleStartedAtUs);
+    sumPipelineLatencyUs += latencyUs;
+    maxPipelineLatencyUs = MAX(maxPipelineLatencyUs, latencyUs);
+    publishedCount++;
+}
+
+int main(int argc, char **argv)
+{
+    chained = !(argc > 1 && strcmp(argv[1], "--polled") == 0);
+
+    new (&tasks[TASK_MAIN]) task_t(DEFINE_TASK("CONTROL", NULL, taskControl, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME));
+    new (&tasks[TASK_SAMPLE]) task_t(DEFINE_TASK("SAMPLE", NULL, taskSample, TASK_PERIOD_US(1900), TASK_PRIORITY_MEDIUM));
+    new (&tasks[TASK_LOGGER]) task_t(DEFINE_TASK("LOGGER", NULL, taskLogger, TASK_PERIOD_US(3300), TASK_PRIORITY_MEDIUM));
+    if (chained) {
+        new (&tasks[TASK_FILTER]) task_t(DEFINE_SIGNAL_TASK("FILTER", taskFilter, TASK_PERIOD_US(2000), TASK_PRIORITY_MEDIUM));
+        new (&tasks[TASK_PUBLISH]) task_t(DEFINE_SIGNAL_TASK("PUBLISH", taskPublish, TASK_PERIOD_US(2000), TASK_PRIORITY_MEDIUM));
+    } else {
+        new (&tasks[TASK_FILTER]) task_t(DEFINE_TASK("FILTER", checkSample, taskFilter, TASK_PERIOD_US(2000), TASK_PRIORITY_MEDIUM));
+        new (&tasks[TASK_PUBLISH]) task_t(DEFINE_TASK("PUBLISH", checkFilter, taskPublish, TASK_PERIOD_US(2000), TASK_PRIORITY_MEDIUM));
+    }
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+    scheduler.resetTaskStates();
+#endif
+    if (chained) {
+        scheduler.addTaskSuccessor((taskId_e)TASK_SAMPLE, (taskId_e)TASK_FILTER);
+        scheduler.addTaskSuccessor((taskId_e)TASK_FILTER, (taskId_e)TASK_PUBLISH);
+    }
+
+    hostClockUseVirtual(true);
+    scheduler.queueClear();
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+    const timeUs_t endUs = micros() + SIM_DURATION_US;
+    uint32_t passes = 0;
+    while (cmpTimeUs(micros(), endUs) < 0) {
+        scheduler.run_scheduler();
+        hostClockAdvanceUs(SIM_PASS_COST_US);
+        passes++;
+    }
+
+    taskInfo_t controlInfo;
+    cfCheckFuncInfo_t checkFuncInfo;
+    scheduler.getTaskInfo(TASK_MAIN, &controlInfo);
+    scheduler.getCheckFuncInfo(&checkFuncInfo);
+    printf("# pipeline, %s\n", chained ? "completion triggers" : "polled checkFuncs");
+    printf("%u samples, %u published, latency avg %d us max %d us, CONTROL late %u times (max %d us), %u passes\n",
+           sampleCount, publishedCount, publishedCount ? (int)(sumPipelineLatencyUs / publishedCount) : 0, (int)maxPipelineLatencyUs,
+           controlInfo.realtimeLateCount, (int)controlInfo.maxRealtimeLatenessUs, passes);
+    if (chained) {
+        taskInfo_t publishInfo;
+        scheduler.getTaskInfo((taskId_e)TASK_PUBLISH, &publishInfo);
+        printf("chain latency max %d us, %u payload errors\n", (int)publishInfo.maxChainLatencyUs, payloadErrors);
+        for (int edge = 0; edge < scheduler.getTaskEdgeCount(); edge++) {
+            taskEdgeInfo_t edgeInfo;
+            scheduler.getTaskEdgeInfo(edge, &edgeInfo);
+            printf("  %-7s -> %-7s %6u triggers, %6u in the same pass, latency avg %d us max %d us\n",
+                   tasks[edgeInfo.taskId].taskName, tasks[edgeInfo.successorId].taskName, edgeInfo.triggerCount,
+                   edgeInfo.samePassCount, (int)edgeInfo.averageLatencyUs, (int)edgeInfo.maxLatencyUs);
+        }
+    } else {
+        printf("checkFunc total %u ms\n", (unsigned)(checkFuncInfo.totalExecutionTimeUs / 1000));
+    }
+    return 0;
+}
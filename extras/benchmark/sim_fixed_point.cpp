@@ -0,0 +1,109 @@
+/*
+ * Side by side check of the fixed-point cycle time average against the float
+ * one. Built twice by the Makefile, the schedule on the virtual clock is the
+ * same in both builds, so the samples fed to the two averages are too. Every
+ * 100 ms the average of every task is printed, the fixed-point build reads
+ * the float build's output back with --compare and checks each sample against
+ * the bound explained in the README:
+ *
+ *   |fixed - float| <= 1.2 us + 2% of the float average
+ */
+#include "Scheduler.h"
+#include "Simulation.h"
+#include <new>
+#include <stdlib.h>
+
+#define BENCH_SAMPLE_US 100000
+#define BENCH_SAMPLES 100
+#define BENCH_BOUND_US 1.2
+#define BENCH_BOUND_RATIO 0.02
+#define BENCH_SETTLED_RUNS 100      // runs after which the averages no longer rise from their start at 0
+
+Scheduler scheduler;
+task_t tasks[TASK_COUNT] = {};
+
+static void taskNop(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *reference = NULL;
+    if (argc > 2 && strcmp(argv[1], "--compare") == 0) {
+        reference = fopen(argv[2], "r");
+        if (!reference) {
+            fprintf(stderr, "can not open %s\n", argv[2]);
+            return 2;
+        }
+    }
+
+    static const timeDelta_t periodsUs[] = { 2000, 5000, 10000, 50000, 100000, 1000000 };
+    new (&tasks[TASK_MAIN]) task_t(DEFINE_TASK("MAIN", NULL, taskNop, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME));
+    for (int taskId = 1; taskId < TASK_COUNT; taskId++) {
+        const timeDelta_t periodUs = periodsUs[taskId % (sizeof(periodsUs) / sizeof(periodsUs[0]))];
+        new (&tasks[taskId]) task_t(DEFINE_TASK("BG", NULL, taskNop, periodUs, (int8_t)(taskId % 2 ? TASK_PRIORITY_MEDIUM : TASK_PRIORITY_LOW)));
+    }
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+    scheduler.resetTaskStates();
+#endif
+
+    Simulation simulation(scheduler, tasks, TASK_COUNT);
+    simulation.setPassCostUs(10);
+    simulation.setTaskModel(TASK_MAIN, 200, 100);
+    for (int taskId = 1; taskId < TASK_COUNT; taskId++) {
+        // Costs up to a few periods of the fast tasks, so their cycle times jitter
+        simulation.setTaskModel(taskId, 100 + 50 * (taskId % 4), 800);
+    }
+
+    scheduler.queueClear();
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+
+    double maxErrorUs = 0;
+    double maxErrorRatio = 0;
+    double maxSettledErrorUs = 0;
+    double maxSettledErrorPercent = 0;
+    int outOfBound = 0;
+    for (int sample = 0; sample < BENCH_SAMPLES; sample++) {
+        simulation.run(BENCH_SAMPLE_US);
+        for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+            taskInfo_t taskInfo;
+            scheduler.getTaskInfo((taskId_e)taskId, &taskInfo);
+            const double averageUs = taskInfo.movingAverageCycleTimeUs;
+            if (!reference) {
+                printf("%d %d %.3f\n", sample, taskId, averageUs);
+                continue;
+            }
+            int referenceSample, referenceTaskId;
+            double referenceUs;
+            if (fscanf(reference, "%d %d %lf", &referenceSample, &referenceTaskId, &referenceUs) != 3
+                || referenceSample != sample || referenceTaskId != taskId) {
+                fprintf(stderr, "reference does not match this task set\n");
+                return 2;
+            }
+            const double errorUs = averageUs > referenceUs ? averageUs - referenceUs : referenceUs - averageUs;
+            const double boundUs = BENCH_BOUND_US + BENCH_BOUND_RATIO * referenceUs;
+            maxErrorUs = MAX(maxErrorUs, errorUs);
+            maxErrorRatio = MAX(maxErrorRatio, errorUs / boundUs);
+            if (simulation.getTaskResult(taskId)->runs >= BENCH_SETTLED_RUNS) {
+                maxSettledErrorUs = MAX(maxSettledErrorUs, errorUs);
+                maxSettledErrorPercent = MAX(maxSettledErrorPercent, 100 * errorUs / referenceUs);
+            }
+            if (errorUs > boundUs) {
+                printf("sample %d task %d: fixed %.0f us, float %.3f us, out of bound by %.3f us\n",
+                       sample, taskId, averageUs, referenceUs, errorUs - boundUs);
+                outOfBound++;
+            }
+        }
+    }
+    if (reference) {
+        printf("%d tasks, %d samples: largest difference %.3f us, %.0f%% of the bound, %d samples out of bound\n",
+               TASK_COUNT, BENCH_SAMPLES, maxErrorUs, 100 * maxErrorRatio, outOfBound);
+        printf("after %d runs: largest difference %.3f us, %.2f%% of the average\n",
+               BENCH_SETTLED_RUNS, maxSettledErrorUs, maxSettledErrorPercent);
+        fclose(reference);
+    }
+    return outOfBound > 0 ? 1 : 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * A 1 kHz realtime task plus a mix of time-driven background tasks whose
+ * periods share common multiples, so several come due on the same pass.
+ */
+#include "Scheduler.h"
+#include "Simulation.h"
+#include <new>
+
+Scheduler scheduler;
+task_t tasks[TASK_COUNT] = {};
+
+static void taskNop(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+}
+
+int main(void)
+{
+    static const timeDelta_t periodsUs[] = { 2000, 4000, 5000, 10000, 20000, 50000, 100000 };
+    static const int8_t priorities[] = { TASK_PRIORITY_HIGH, TASK_PRIORITY_MEDIUM, TASK_PRIORITY_LOW };
+
+    new (&tasks[TASK_MAIN]) task_t(DEFINE_TASK("MAIN", NULL, taskNop, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME));
+    for (int taskId = 1; taskId < TASK_COUNT; taskId++) {
+        const timeDelta_t periodUs = periodsUs[taskId % (sizeof(periodsUs) / sizeof(periodsUs[0]))];
+        new (&tasks[taskId]) task_t(DEFINE_TASK("BG", NULL, taskNop, periodUs, priorities[taskId % 3]));
+    }
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+    scheduler.resetTaskStates();
+#endif
+
+    Simulation simulation(scheduler, tasks, TASK_COUNT);
+    simulation.setPassCostUs(10);
+    simulation.setTaskModel(TASK_MAIN, 200, 100);
+    for (int taskId = 1; taskId < TASK_COUNT; taskId++) {
+        simulation.setTaskModel(taskId, 60 + 20 * (taskId % 5), 40);
+    }
+
+    scheduler.queueClear();
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+    simulation.run(10 * 1000000);
+    simulation.report("mixed");
+    return 0;
+}
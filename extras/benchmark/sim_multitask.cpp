@@ -0,0 +1,41 @@
+/*
+ * Replays the task set of examples/Multitask on the virtual clock.
+ * Costs are rough figures for a 16 MHz AVR, INFO is dominated by printTasks().
+ * With --tickless idle passes sleep until the next task is due.
+ */
+#include "Scheduler.h"
+#include "Simulation.h"
+
+Scheduler scheduler;
+
+static void taskNop(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+}
+
+task_t tasks[TASK_COUNT] = {
+    [TASK_SYSTEM] = DEFINE_TASK("SYSTEM", NULL, taskNop, TASK_PERIOD_MS(100), TASK_PRIORITY_MEDIUM_HIGH),
+    [TASK_MAIN] = DEFINE_TASK("MAIN", NULL, taskNop, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME),
+    [TASK_INFO] = DEFINE_TASK("INFO", NULL, taskNop, TASK_PERIOD_MS(2000), TASK_PRIORITY_LOW),
+    [TASK_BLINK] = DEFINE_TASK("BLINK", NULL, taskNop, TASK_PERIOD_MS(1000), TASK_PRIORITY_HIGH),
+};
+
+int main(int argc, char **argv)
+{
+    const bool tickless = argc > 1 && strcmp(argv[1], "--tickless") == 0;
+    Simulation simulation(scheduler, tasks, TASK_COUNT);
+    simulation.setTickless(tickless);
+    simulation.setPassCostUs(20);
+    simulation.setTaskModel(TASK_SYSTEM, 15);
+    simulation.setTaskModel(TASK_MAIN, 150, 50);
+    simulation.setTaskModel(TASK_INFO, 4000, 1000);
+    simulation.setTaskModel(TASK_BLINK, 200);
+
+    scheduler.queueClear();
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+    simulation.run(10 * 1000000);
+    simulation.report(tickless ? "multitask, tickless idle" : "multitask");
+    return 0;
+}
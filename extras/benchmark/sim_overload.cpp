@@ -0,0 +1,76 @@
+/*
+ * Bursty load: seven low priority tasks grow their cost about fourfold for a
+ * few seconds, pushing the demand past 100%. With the overload governor their
+ * periods are stretched while the burst lasts and restored afterwards. The
+ * realtime MAIN task is protected, its time does not count toward the ceiling
+ * and it is not stretched. It misses fewer periods because background runs
+ * delay it less often. Its worst lateness stays the same, that is set by the
+ * longest single background run. --no-governor runs the same load without it.
+ */
+#include "Scheduler.h"
+#include "Simulation.h"
+#include <new>
+
+Scheduler scheduler;
+task_t tasks[TASK_COUNT] = {};
+
+static void taskNop(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+}
+
+static void setBackgroundCost(Simulation &simulation, timeDelta_t costUs, timeDelta_t costJitterUs)
+{
+    for (int taskId = TASK_MAIN + 1; taskId < TASK_COUNT; taskId++) {
+        simulation.setTaskModel(taskId, costUs, costJitterUs);
+    }
+}
+
+static void reportGovernor(const char *phase)
+{
+    overloadInfo_t overloadInfo;
+    scheduler.getOverloadInfo(&overloadInfo);
+    printf("%-8s load %3u%%, stretch %3u%%, %u overloaded windows\n", phase,
+           overloadInfo.utilizationPercent, overloadInfo.stretchPercent, overloadInfo.overloadWindows);
+}
+
+int main(int argc, char **argv)
+{
+    const bool governor = !(argc > 1 && strcmp(argv[1], "--no-governor") == 0);
+
+    new (&tasks[TASK_MAIN]) task_t(DEFINE_TASK("MAIN", NULL, taskNop, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME));
+    for (int taskId = TASK_MAIN + 1; taskId < TASK_COUNT; taskId++) {
+        new (&tasks[taskId]) task_t(DEFINE_TASK("BG", NULL, taskNop, TASK_PERIOD_MS(10), TASK_PRIORITY_LOW));
+    }
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+    scheduler.resetTaskStates();
+#endif
+    for (int taskId = TASK_MAIN + 1; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskBudget((taskId_e)taskId, 800);
+    }
+
+    Simulation simulation(scheduler, tasks, TASK_COUNT);
+    simulation.setPassCostUs(10);
+    simulation.setTaskModel(TASK_MAIN, 150, 50);
+    scheduler.setOverloadCeiling(governor ? 60 : 100);
+
+    scheduler.queueClear();
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+    setBackgroundCost(simulation, 400, 100);
+    simulation.run(2 * 1000000);
+    reportGovernor("normal");
+    setBackgroundCost(simulation, 1800, 400);
+    simulation.run(3 * 1000000);
+    reportGovernor("burst");
+    setBackgroundCost(simulation, 400, 100);
+    simulation.run(3 * 1000000);
+    reportGovernor("normal");
+    simulation.report(governor ? "overload, governor" : "overload, no governor");
+
+    taskInfo_t taskInfo;
+    scheduler.getTaskInfo((taskId_e)(TASK_MAIN + 1), &taskInfo);
+    printf("BG budget %d us, %u overruns, max overrun %d us\n", (int)taskInfo.budgetUs, taskInfo.budgetOverrunCount, (int)taskInfo.maxBudgetOverrunUs);
+    return 0;
+}
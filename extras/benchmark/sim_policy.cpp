@@ -0,0 +1,49 @@
+/*
+ * Background tasks with unrelated periods at about 90% load, replayed once per
+ * dispatch policy (SCHEDULER_POLICY is set by the Makefile). A run counts as a
+ * missed deadline in the "missed" column when it starts more than a period
+ * after it was due.
+ */
+#include "Scheduler.h"
+#include "Simulation.h"
+
+#define TASK_STATUS 1
+#define TASK_FILTER 2
+#define TASK_LINK 3
+#define TASK_STORE 4
+#define SIM_STRINGIFY(x) #x
+#define SIM_POLICY_NAME(x) SIM_STRINGIFY(x)
+
+Scheduler scheduler;
+
+static void taskNop(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+}
+
+task_t tasks[TASK_COUNT] = {
+    [TASK_MAIN] = DEFINE_TASK("SENSOR", NULL, taskNop, TASK_PERIOD_US(2000), TASK_PRIORITY_LOW),
+    [TASK_STATUS] = DEFINE_TASK("STATUS", NULL, taskNop, TASK_PERIOD_US(3000), TASK_PRIORITY_HIGH),
+    [TASK_FILTER] = DEFINE_TASK("FILTER", NULL, taskNop, TASK_PERIOD_US(5000), TASK_PRIORITY_MEDIUM),
+    [TASK_LINK] = DEFINE_TASK("LINK", NULL, taskNop, TASK_PERIOD_US(7000), TASK_PRIORITY_LOW),
+    [TASK_STORE] = DEFINE_TASK("STORE", NULL, taskNop, TASK_PERIOD_US(11000), TASK_PRIORITY_MEDIUM_HIGH),
+};
+
+int main(void)
+{
+    Simulation simulation(scheduler, tasks, TASK_COUNT);
+    simulation.setPassCostUs(10);
+    simulation.setTaskModel(TASK_MAIN, 400, 100);
+    simulation.setTaskModel(TASK_STATUS, 600, 100);
+    simulation.setTaskModel(TASK_FILTER, 900, 200);
+    simulation.setTaskModel(TASK_LINK, 1000, 300);
+    simulation.setTaskModel(TASK_STORE, 1200, 400);
+
+    scheduler.queueClear();
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+    simulation.run(10 * 1000000);
+    simulation.report(SIM_POLICY_NAME(SCHEDULER_POLICY));
+    return 0;
+}
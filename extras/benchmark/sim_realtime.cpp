@@ -0,0 +1,80 @@
+/*
+ * Two realtime loops, a 1 kHz control loop and a 500 Hz sensor fusion loop,
+ * sharing the CPU with background tasks of a few hundred microseconds.
+ * Built with USE_SCHEDULER_TRACE, --trace appends the trace blob of the run up
+ * to the first deadline miss to the output. --check-func gives the control loop
+ * a checkFunc that is always ready. The realtime lane runs it by its period, the
+ * background selection must neither poll the checkFunc nor run the task.
+ */
+#include "Scheduler.h"
+#include "Simulation.h"
+
+Scheduler scheduler;
+
+static void taskNop(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+}
+
+static uint32_t checkFuncCalls;
+
+static bool checkAlways(timeUs_t currentTimeUs, timeDelta_t currentDeltaTimeUs)
+{
+    (void)currentTimeUs;
+    (void)currentDeltaTimeUs;
+    checkFuncCalls++;
+    return true;
+}
+
+task_t tasks[TASK_COUNT] = {
+    [TASK_SYSTEM] = DEFINE_TASK("FUSION", NULL, taskNop, TASK_PERIOD_US(2000), TASK_PRIORITY_REALTIME),
+    [TASK_MAIN] = DEFINE_TASK("CONTROL", NULL, taskNop, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME),
+    [TASK_INFO] = DEFINE_TASK("TELEMETRY", NULL, taskNop, TASK_PERIOD_MS(20), TASK_PRIORITY_LOW),
+    [TASK_BLINK] = DEFINE_TASK("LOGGER", NULL, taskNop, TASK_PERIOD_MS(5), TASK_PRIORITY_MEDIUM),
+};
+
+int main(int argc, char *argv[])
+{
+    const bool trace = argc > 1 && strcmp(argv[1], "--trace") == 0;
+    const bool checkFunc = argc > 1 && strcmp(argv[1], "--check-func") == 0;
+    if (checkFunc) {
+        tasks[TASK_MAIN].checkFunc = checkAlways;
+    }
+    Simulation simulation(scheduler, tasks, TASK_COUNT);
+    simulation.setPassCostUs(10);
+    simulation.setTaskModel(TASK_SYSTEM, 250, 50);
+    simulation.setTaskModel(TASK_MAIN, 150, 30);
+    simulation.setTaskModel(TASK_INFO, 400, 200);
+    simulation.setTaskModel(TASK_BLINK, 300, 100);
+
+    scheduler.queueClear();
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+#if defined(USE_SCHEDULER_TRACE)
+    scheduler.setTraceStopOnMiss(trace);
+#endif
+    simulation.run(10 * 1000000);
+    simulation.report(checkFunc ? "realtime, CONTROL with a checkFunc" : "realtime");
+
+    printf("%-10s %8s %12s\n", "realtime", "late", "max late/us");
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        taskInfo_t taskInfo;
+        scheduler.getTaskInfo((taskId_e)taskId, &taskInfo);
+        if (taskInfo.staticPriority == TASK_PRIORITY_REALTIME) {
+            printf("%-10s %8u %12d\n", taskInfo.taskName, (unsigned)taskInfo.realtimeLateCount, (int)taskInfo.maxRealtimeLatenessUs);
+        }
+    }
+    if (checkFunc) {
+        printf("CONTROL checkFunc polled %u times\n", (unsigned)checkFuncCalls);
+    }
+#if defined(USE_SCHEDULER_TRACE)
+    if (trace) {
+        fflush(stdout);
+        scheduler.dumpTrace();
+    }
+#else
+    (void)trace;
+#endif
+    return 0;
+}
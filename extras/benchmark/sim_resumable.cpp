@@ -0,0 +1,69 @@
+/*
+ * A 1 kHz realtime task next to a 5 ms job (think flash write) every 50 ms.
+ * Run to completion the job blocks MAIN for whole periods, as a resumable
+ * task it is cut into 250 us chunks that yield before the next MAIN deadline.
+ * --blocking runs the job as a plain task.
+ */
+#include "Scheduler.h"
+#include "Simulation.h"
+#include <new>
+
+#define TASK_FLASH 1
+#define FLASH_CHUNKS 20
+#define FLASH_CHUNK_US 250
+
+Scheduler scheduler;
+task_t tasks[TASK_COUNT] = {};
+
+static void taskNop(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+}
+
+static taskResume_e taskFlash(taskCoroutine_t *co, timeUs_t currentTimeUs)
+{
+    static int chunk;
+    (void)currentTimeUs;
+    TASK_BEGIN(co);
+    for (chunk = 0; chunk < FLASH_CHUNKS; chunk++) {
+        TASK_YIELD_IF_NO_ROOM(co, FLASH_CHUNK_US);
+        hostClockAdvanceUs(FLASH_CHUNK_US);
+    }
+    TASK_END(co);
+}
+
+int main(int argc, char **argv)
+{
+    const bool blocking = argc > 1 && strcmp(argv[1], "--blocking") == 0;
+
+    new (&tasks[TASK_MAIN]) task_t(DEFINE_TASK("MAIN", NULL, taskNop, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME));
+    if (blocking) {
+        new (&tasks[TASK_FLASH]) task_t(DEFINE_TASK("FLASH", NULL, taskNop, TASK_PERIOD_MS(50), TASK_PRIORITY_LOW));
+    } else {
+        new (&tasks[TASK_FLASH]) task_t(DEFINE_RESUMABLE_TASK("FLASH", taskFlash, TASK_PERIOD_MS(50), TASK_PRIORITY_LOW));
+    }
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+    scheduler.resetTaskStates();
+#endif
+
+    Simulation simulation(scheduler, tasks, TASK_COUNT);
+    simulation.setPassCostUs(10);
+    simulation.setTaskModel(TASK_MAIN, 150, 50);
+    simulation.setTaskModel(TASK_FLASH, FLASH_CHUNKS * FLASH_CHUNK_US);
+
+    scheduler.queueClear();
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+    simulation.run(10 * 1000000);
+    simulation.report(blocking ? "resumable, FLASH run to completion" : "resumable, FLASH in slices");
+
+    if (!blocking) {
+        taskInfo_t taskInfo;
+        scheduler.getTaskInfo((taskId_e)TASK_FLASH, &taskInfo);
+        printf("FLASH %u slices, %u overran, %u slices per run (max %u), max slice %u us\n",
+               taskInfo.sliceCount, taskInfo.sliceOverrunCount, taskInfo.latestRunSlices, taskInfo.maxRunSlices,
+               (unsigned)taskInfo.maxExecutionTimeUs);
+    }
+    return 0;
+}
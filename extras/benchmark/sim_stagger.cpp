@@ -0,0 +1,64 @@
+/*
+ * Sensor and housekeeping tasks with equal and harmonic periods next to two
+ * 1 kHz realtime tasks, on the virtual clock. Built twice by the Makefile, the
+ * second time with USE_SCHEDULER_PHASE_STAGGER so the tasks start spread over
+ * their periods instead of all coming due on the first pass.
+ */
+#include "Scheduler.h"
+#include "Simulation.h"
+
+#define TASK_CONTROL 1
+#define TASK_ACC 2
+#define TASK_BARO 3
+#define TASK_MAG 4
+#define TASK_RX 5
+#define TASK_TELEMETRY 6
+#define TASK_OSD 7
+#define TASK_BLINK 8
+
+Scheduler scheduler;
+
+static void taskNop(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+}
+
+task_t tasks[TASK_COUNT] = {
+    [TASK_MAIN] = DEFINE_TASK("GYRO", NULL, taskNop, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME),
+    [TASK_CONTROL] = DEFINE_TASK("CONTROL", NULL, taskNop, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME),
+    [TASK_ACC] = DEFINE_TASK("ACC", NULL, taskNop, TASK_PERIOD_MS(5), TASK_PRIORITY_MEDIUM_HIGH),
+    [TASK_BARO] = DEFINE_TASK("BARO", NULL, taskNop, TASK_PERIOD_MS(5), TASK_PRIORITY_MEDIUM),
+    [TASK_MAG] = DEFINE_TASK("MAG", NULL, taskNop, TASK_PERIOD_MS(5), TASK_PRIORITY_MEDIUM),
+    [TASK_RX] = DEFINE_TASK("RX", NULL, taskNop, TASK_PERIOD_MS(10), TASK_PRIORITY_HIGH),
+    [TASK_TELEMETRY] = DEFINE_TASK("TELEMETRY", NULL, taskNop, TASK_PERIOD_MS(10), TASK_PRIORITY_LOW),
+    [TASK_OSD] = DEFINE_TASK("OSD", NULL, taskNop, TASK_PERIOD_MS(20), TASK_PRIORITY_LOW),
+    [TASK_BLINK] = DEFINE_TASK("BLINK", NULL, taskNop, TASK_PERIOD_MS(20), TASK_PRIORITY_LOW),
+};
+
+int main(void)
+{
+    Simulation simulation(scheduler, tasks, TASK_COUNT);
+    simulation.setPassCostUs(10);
+    simulation.setLoadWindowUs(1000);
+    simulation.setTaskModel(TASK_MAIN, 100);
+    simulation.setTaskModel(TASK_CONTROL, 120);
+    simulation.setTaskModel(TASK_ACC, 250);
+    simulation.setTaskModel(TASK_BARO, 250);
+    simulation.setTaskModel(TASK_MAG, 250);
+    simulation.setTaskModel(TASK_RX, 300);
+    simulation.setTaskModel(TASK_TELEMETRY, 400);
+    simulation.setTaskModel(TASK_OSD, 600);
+    simulation.setTaskModel(TASK_BLINK, 50);
+
+    scheduler.queueClear();
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+    simulation.run(10 * 1000000);
+#if defined(USE_SCHEDULER_PHASE_STAGGER)
+    simulation.report("harmonic periods, staggered phases");
+#else
+    simulation.report("harmonic periods");
+#endif
+    return 0;
+}
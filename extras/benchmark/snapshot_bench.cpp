@@ -0,0 +1,94 @@
+/*
+ * Cost of reporting the task statistics on the system clock: printTasks()
+ * against takeSnapshot() and the streamSnapshot() calls that send the frame.
+ * stdout stands in for the serial port, so the results go to stderr. The run
+ * ends with a snapshot taken without resetting the max values followed by
+ * printTasks(), extras/tools/snapshot2table.py turns the frame back into the
+ * same table.
+ */
+#include "Scheduler.h"
+#include <new>
+#include <stdio.h>
+
+#define BENCH_WARMUP_US 500000
+#define BENCH_PRINT_CALLS 200
+#define BENCH_SNAPSHOT_CALLS 2000
+
+Scheduler scheduler;
+task_t tasks[TASK_COUNT] = {};
+static char taskNames[TASK_COUNT][8];
+
+static void spinUs(timeDelta_t durationUs)
+{
+    const timeUs_t startUs = micros();
+    while (cmpTimeUs(micros(), startUs) < durationUs) {
+    }
+}
+
+static void taskMain(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    spinUs(20);
+}
+
+static void taskBody(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    spinUs(5);
+}
+
+int main(void)
+{
+    new (&tasks[TASK_MAIN]) task_t(DEFINE_TASK("MAIN", NULL, taskMain, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME));
+    for (int taskId = 1; taskId < TASK_COUNT; taskId++) {
+        snprintf(taskNames[taskId], sizeof(taskNames[taskId]), "BG%02d", taskId);
+        new (&tasks[taskId]) task_t(DEFINE_TASK(taskNames[taskId], NULL, taskBody, TASK_PERIOD_MS(1 + taskId % 16), TASK_PRIORITY_MEDIUM));
+    }
+    scheduler.queueClear();
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+    }
+    scheduler.debug(true);
+    const timeUs_t warmupStartUs = micros();
+    while (cmpTimeUs(micros(), warmupStartUs) < BENCH_WARMUP_US) {
+        scheduler.run_scheduler();
+    }
+
+    timeUs_t startUs = micros();
+    for (int ii = 0; ii < BENCH_PRINT_CALLS; ii++) {
+        scheduler.printTasks();
+    }
+    const double printUs = (double)(micros() - startUs) / BENCH_PRINT_CALLS;
+
+    startUs = micros();
+    uint16_t frameBytes = 0;
+    for (int ii = 0; ii < BENCH_SNAPSHOT_CALLS; ii++) {
+        frameBytes = scheduler.takeSnapshot();
+    }
+    const double snapshotUs = (double)(micros() - startUs) / BENCH_SNAPSHOT_CALLS;
+
+    int streamCalls = 0;
+    startUs = micros();
+    while (scheduler.streamSnapshot()) {
+        streamCalls++;
+    }
+    const double streamUs = (double)(micros() - startUs) / MAX(streamCalls, 1);
+
+    const timeUs_t runStartUs = micros();
+    while (cmpTimeUs(micros(), runStartUs) < BENCH_WARMUP_US) {
+        scheduler.run_scheduler();
+    }
+    scheduler.takeSnapshot(false);
+    while (scheduler.streamSnapshot()) {
+    }
+    scheduler.printTasks();
+    fflush(stdout);
+
+    snapshotInfo_t snapshotInfo;
+    scheduler.getSnapshotInfo(&snapshotInfo);
+    fprintf(stderr, "%d tasks: printTasks %.1f us, takeSnapshot %.2f us for %u bytes, streamSnapshot %.2f us per %d byte chunk\n",
+            TASK_COUNT, printUs, snapshotUs, frameBytes, streamUs, SCHEDULER_SNAPSHOT_STREAM_BUDGET);
+    fprintf(stderr, "frames taken %u, sent %u, replaced %u\n",
+            snapshotInfo.takenFrames, snapshotInfo.sentFrames, snapshotInfo.replacedFrames);
+    return 0;
+}
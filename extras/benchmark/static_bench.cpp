@@ -0,0 +1,106 @@
+/*
+ * Cost of a scheduler pass for the same 8 task set declared at run time
+ * (Scheduler with a task_t table) and at compile time (StaticScheduler).
+ * Task bodies are empty, as in queue_bench. Also checks that StaticScheduler
+ * runs due realtime tasks earliest deadline first, not in declaration order.
+ */
+#include "Scheduler.h"
+#include "StaticScheduler.h"
+#include <new>
+#include <time.h>
+
+#define BENCH_DURATION_NS 500000000ULL
+
+static uint32_t dispatchedTasks;
+
+static void taskBody(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    dispatchedTasks++;
+}
+
+static bool checkNever(timeUs_t currentTimeUs, timeDelta_t currentDeltaTimeUs)
+{
+    (void)currentTimeUs;
+    (void)currentDeltaTimeUs;
+    return false;
+}
+
+Scheduler scheduler;
+task_t tasks[TASK_COUNT] = {};
+
+StaticScheduler<true,
+    StaticTask<taskBody, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME>,
+    StaticTask<taskBody, TASK_PERIOD_MS(2), TASK_PRIORITY_HIGH>,
+    StaticTask<taskBody, TASK_PERIOD_MS(3), TASK_PRIORITY_MEDIUM>,
+    StaticTask<taskBody, TASK_PERIOD_MS(4), TASK_PRIORITY_LOW>,
+    StaticTask<taskBody, TASK_PERIOD_MS(5), TASK_PRIORITY_HIGH>,
+    StaticTask<taskBody, TASK_PERIOD_MS(6), TASK_PRIORITY_MEDIUM>,
+    StaticTask<taskBody, TASK_PERIOD_MS(7), TASK_PRIORITY_LOW>,
+    StaticTask<taskBody, TASK_PERIOD_MS(8), TASK_PRIORITY_MEDIUM, checkNever>
+> staticScheduler;
+
+// The second one is due first, its period is shorter and both last ran at 0
+static char realtimeOrder[3];
+static int realtimeRuns;
+static void taskSlowLoop(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    realtimeOrder[MIN(realtimeRuns++, 1)] = 'S';
+}
+static void taskFastLoop(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    realtimeOrder[MIN(realtimeRuns++, 1)] = 'F';
+}
+
+StaticScheduler<false,
+    StaticTask<taskSlowLoop, TASK_PERIOD_US(2000), TASK_PRIORITY_REALTIME>,
+    StaticTask<taskFastLoop, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME>
+> realtimeOrderScheduler;
+
+static uint64_t monotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+template<typename SchedulerType> static void measure(const char *name, SchedulerType *bench)
+{
+    dispatchedTasks = 0;
+    uint64_t passes = 0;
+    const uint64_t startNs = monotonicNs();
+    const uint64_t endNs = startNs + BENCH_DURATION_NS;
+    while (monotonicNs() < endNs) {
+        bench->run_scheduler();
+        passes++;
+    }
+    printf("%-8s %10.1f ns/pass %12llu passes %10u dispatched\n", name,
+           (double)(monotonicNs() - startNs) / passes, (unsigned long long)passes, dispatchedTasks);
+}
+
+int main(void)
+{
+    static const int8_t priorities[] = { TASK_PRIORITY_HIGH, TASK_PRIORITY_MEDIUM, TASK_PRIORITY_LOW };
+
+    new (&tasks[TASK_MAIN]) task_t(DEFINE_TASK("MAIN", NULL, taskBody, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME));
+    for (int taskId = 1; taskId < TASK_COUNT; taskId++) {
+        new (&tasks[taskId]) task_t(DEFINE_TASK("BG", taskId == 7 ? checkNever : NULL, taskBody, TASK_PERIOD_MS(1 + taskId), priorities[(taskId - 1) % 3]));
+    }
+    scheduler.queueClear();
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        scheduler.setTaskEnabled((taskId_e)taskId, true);
+        staticScheduler.setTaskEnabled(taskId, true);
+    }
+
+    measure("dynamic", &scheduler);
+    measure("static", &staticScheduler);
+
+    realtimeOrderScheduler.setTaskEnabled(0, true);
+    realtimeOrderScheduler.setTaskEnabled(1, true);
+    realtimeOrderScheduler.run_scheduler();
+    const bool edf = strcmp(realtimeOrder, "FS") == 0;
+    printf("static realtime order %s, %s\n", realtimeOrder, edf ? "earliest deadline first" : "NOT earliest deadline first");
+    return edf ? 0 : 1;
+}
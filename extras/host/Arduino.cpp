@@ -0,0 +1,114 @@
+#include "Arduino.h"
+#include "HostClock.h"
+#include <time.h>
+
+HardwareSerial Serial;
+
+static uint8_t pinState[64];
+
+static uint64_t monotonicUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static const uint64_t bootUs = monotonicUs();
+static bool virtualClock = false;
+static uint64_t virtualClockUs = 0;
+
+void hostClockUseVirtual(bool enabled)
+{
+    virtualClock = enabled;
+}
+
+bool hostClockIsVirtual(void)
+{
+    return virtualClock;
+}
+
+void hostClockSetUs(uint64_t timeUs)
+{
+    virtualClockUs = timeUs;
+}
+
+void hostClockAdvanceUs(uint64_t deltaUs)
+{
+    virtualClockUs += deltaUs;
+}
+
+uint64_t hostClockNowUs(void)
+{
+    return virtualClock ? virtualClockUs : monotonicUs() - bootUs;
+}
+
+unsigned long micros(void)
+{
+    return (unsigned long)hostClockNowUs();
+}
+
+unsigned long millis(void)
+{
+    return micros() / 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    if (virtualClock) {
+        virtualClockUs += us;
+        return;
+    }
+    const unsigned long startUs = micros();
+    while (micros() - startUs < us) {
+    }
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    pinState[pin % sizeof(pinState)] = val;
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pinState[pin % sizeof(pinState)];
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+    (void)baud;
+}
+
+size_t HardwareSerial::print(const char *str)
+{
+    return fputs(str, stdout) < 0 ? 0 : strlen(str);
+}
+
+size_t HardwareSerial::println(const char *str)
+{
+    const size_t written = print(str);
+    fputc('\n', stdout);
+    return written + 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    return fwrite(buffer, 1, size, stdout);
+}
+
+static bool serialStalled = false;
+
+void hostSerialStall(bool stalled)
+{
+    serialStalled = stalled;
+}
+
+int HardwareSerial::availableForWrite(void)
+{
+    return serialStalled ? 0 : 64;
+}
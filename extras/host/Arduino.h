@@ -0,0 +1,38 @@
+#pragma once
+
+// Minimal stand-in for the Arduino core so the scheduler builds and runs on a Linux host
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define LED_BUILTIN 13
+#define OUTPUT 1
+#define INPUT 0
+#define HIGH 1
+#define LOW 0
+
+unsigned long micros(void);
+unsigned long millis(void);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+class HardwareSerial
+{
+    public:
+        void begin(unsigned long baud);
+        size_t print(const char *str);
+        size_t println(const char *str);
+        size_t write(const uint8_t *buffer, size_t size);
+        int availableForWrite(void);
+};
+
+extern HardwareSerial Serial;
+
+// Host only, a stalled port reports no room to writers polling availableForWrite()
+void hostSerialStall(bool stalled);
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host only control of the clock behind micros() and millis(). The default is
+// the monotonic system clock, the virtual clock only moves when it is stepped.
+void hostClockUseVirtual(bool enabled);
+bool hostClockIsVirtual(void);
+void hostClockSetUs(uint64_t timeUs);
+void hostClockAdvanceUs(uint64_t deltaUs);
+uint64_t hostClockNowUs(void);
@@ -0,0 +1,131 @@
+#include "HostExecutor.h"
+
+#if defined(USE_SCHEDULER_EXECUTOR)
+
+#include <pthread.h>
+
+#define HOST_EXECUTOR_IDLE_WAIT_US 1000    // a worker waiting for work looks for tasks to steal this often
+
+// The scheduler keeps TASK_SELF for its own thread and each worker
+static int hostExecutorWorkers(int workerCount)
+{
+    return MAX(1, MIN(workerCount, SCHEDULER_EXECUTOR_THREADS - 1));
+}
+
+HostExecutor::HostExecutor(Scheduler &scheduler, int workerCount, int maxQueuedPerWorker)
+    : scheduler(scheduler), maxQueued(hostExecutorWorkers(workerCount) * MAX(1, maxQueuedPerWorker)),
+      queuedTasks(0), running(true), submittedTasks(0), stolenTasks(0)
+{
+    for (int ii = 0; ii < hostExecutorWorkers(workerCount); ii++) {
+        workers.emplace_back(new Worker());
+    }
+    // Started once the vector is complete, workers look at each other's deques
+    for (size_t ii = 0; ii < workers.size(); ii++) {
+        workers[ii]->thread = std::thread(&HostExecutor::workerLoop, this, (int)ii);
+    }
+}
+
+HostExecutor::~HostExecutor()
+{
+    {
+        std::lock_guard<std::mutex> guard(wakeMutex);
+        running = false;
+    }
+    wake.notify_all();
+    for (auto &worker : workers) {
+        worker->thread.join();
+    }
+}
+
+bool HostExecutor::submit(task_t *task, timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    if (queuedTasks >= maxQueued) {
+        return false;
+    }
+    Worker &worker = *workers[nextWorker];
+    nextWorker = (nextWorker + 1) % workers.size();
+    {
+        std::lock_guard<std::mutex> guard(worker.mutex);
+        worker.tasks.push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> guard(wakeMutex);
+        queuedTasks++;
+    }
+    submittedTasks++;
+    wake.notify_one();
+    return true;
+}
+
+task_t *HostExecutor::completed(timeUs_t *executionTimeUs)
+{
+    std::lock_guard<std::mutex> guard(completedMutex);
+    if (completedTasks.empty()) {
+        return NULL;
+    }
+    task_t *task = completedTasks.front().first;
+    *executionTimeUs = completedTasks.front().second;
+    completedTasks.pop_front();
+    return task;
+}
+
+void HostExecutor::lock(void)
+{
+    schedulerMutex.lock();
+}
+
+void HostExecutor::unlock(void)
+{
+    schedulerMutex.unlock();
+}
+
+/*
+ * Own deque first, oldest task first. Otherwise steal the newest task of
+ * another worker, the one its owner would have got to last.
+ */
+task_t *HostExecutor::take(int index)
+{
+    const int workerCount = workers.size();
+    for (int ii = 0; ii < workerCount; ii++) {
+        Worker &worker = *workers[(index + ii) % workerCount];
+        std::lock_guard<std::mutex> guard(worker.mutex);
+        if (worker.tasks.empty()) {
+            continue;
+        }
+        task_t *task;
+        if (ii == 0) {
+            task = worker.tasks.front();
+            worker.tasks.pop_front();
+        } else {
+            task = worker.tasks.back();
+            worker.tasks.pop_back();
+            stolenTasks++;
+        }
+        queuedTasks--;
+        return task;
+    }
+    return NULL;
+}
+
+void HostExecutor::workerLoop(int index)
+{
+    // A worker sharing a core with the thread calling run_scheduler() gives way as soon as that one wakes
+    const struct sched_param param = {};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+    while (running) {
+        task_t *task = take(index);
+        if (!task) {
+            std::unique_lock<std::mutex> guard(wakeMutex);
+            wake.wait_for(guard, std::chrono::microseconds(HOST_EXECUTOR_IDLE_WAIT_US), [this] { return queuedTasks > 0 || !running; });
+            continue;
+        }
+        // The scheduler never hands out a task twice before it is collected, so
+        // its statistics are only ever written by the thread running it
+        const timeUs_t executionTimeUs = scheduler.schedulerExecuteTask(task, micros());
+        std::lock_guard<std::mutex> guard(completedMutex);
+        completedTasks.push_back(std::make_pair(task, executionTimeUs));
+    }
+}
+
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Scheduler.h"
+
+#if defined(USE_SCHEDULER_EXECUTOR)
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+ * Work-stealing executor for the host port. Every worker thread has its own
+ * deque, submit() deals tasks out round robin, a worker takes from the front
+ * of its own deque and steals from the back of the others when it runs dry.
+ * The thread calling run_scheduler() keeps the realtime lane:
+ *
+ *   HostExecutor executor(scheduler, 4);
+ *   scheduler.setExecutor(&executor);
+ *
+ * At most maxQueuedPerWorker tasks wait per worker, so priorities are decided
+ * by the scheduler and not by a long backlog.
+ */
+class HostExecutor : public SchedulerExecutor
+{
+    public:
+        HostExecutor(Scheduler &scheduler, int workerCount, int maxQueuedPerWorker = 2);
+        ~HostExecutor();
+
+        bool submit(task_t *task, timeUs_t currentTimeUs) override;
+        task_t *completed(timeUs_t *executionTimeUs) override;
+        void lock(void) override;
+        void unlock(void) override;
+
+        uint32_t getSubmittedTasks(void) const { return submittedTasks; }
+        uint32_t getStolenTasks(void) const { return stolenTasks; }
+
+    private:
+        struct Worker {
+            std::mutex mutex;
+            std::deque<task_t *> tasks;
+            std::thread thread;
+        };
+
+        void workerLoop(int index);
+        task_t *take(int index);
+
+        Scheduler &scheduler;
+        std::vector<std::unique_ptr<Worker>> workers;
+        const int maxQueued;
+        int nextWorker = 0;
+        std::recursive_mutex schedulerMutex;
+        std::mutex wakeMutex;
+        std::condition_variable wake;
+        std::mutex completedMutex;
+        std::deque<std::pair<task_t *, timeUs_t>> completedTasks;
+        std::atomic<int> queuedTasks;
+        std::atomic<bool> running;
+        std::atomic<uint32_t> submittedTasks;
+        std::atomic<uint32_t> stolenTasks;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "HostSleep.h"
+#include "HostClock.h"
+#include <sys/prctl.h>
+#include <time.h>
+
+#define HOST_SLEEP_SLICE_US 100     // how often a sleeping thread looks at *signalPending
+
+void hostSchedulerSleep(timeUs_t wakeAtUs, const volatile uint8_t *signalPending)
+{
+    const timeDelta_t sleepUs = cmpTimeUs(wakeAtUs, micros());
+    if (sleepUs <= 0 || __atomic_load_n(signalPending, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    if (hostClockIsVirtual()) {
+        hostClockAdvanceUs(sleepUs);
+        return;
+    }
+    // Linux lets a sleep run 50 us over by default, more than the guard interval
+    static thread_local bool timerSlackSet = false;
+    if (!timerSlackSet) {
+        prctl(PR_SET_TIMERSLACK, 1UL);
+        timerSlackSet = true;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const uint64_t wakeNs = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec + (uint64_t)sleepUs * 1000;
+    for (uint64_t sliceNs = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec; sliceNs < wakeNs; ) {
+        sliceNs = MIN(sliceNs + HOST_SLEEP_SLICE_US * 1000ULL, wakeNs);
+        const struct timespec slice = { (time_t)(sliceNs / 1000000000ULL), (long)(sliceNs % 1000000000ULL) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &slice, NULL);
+        if (__atomic_load_n(signalPending, __ATOMIC_ACQUIRE)) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "Scheduler.h"
+
+// Tickless idle hook for the host port. Sleeps with clock_nanosleep on the
+// system clock, or jumps the virtual clock straight to wakeAtUs. Returns early
+// once *signalPending is set by signalTask() from another thread.
+void hostSchedulerSleep(timeUs_t wakeAtUs, const volatile uint8_t *signalPending);
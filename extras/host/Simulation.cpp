@@ -0,0 +1,215 @@
+#include "Simulation.h"
+#include <math.h>
+#include <time.h>
+
+static Simulation *activeSimulation = NULL;
+static bool taskRanThisPass;
+
+static uint64_t monotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Task functions carry no context, so every task id gets its own trampoline
+template<int taskId> static void simTaskFunc(timeUs_t currentTimeUs)
+{
+    (void)currentTimeUs;
+    activeSimulation->recordTaskStart(taskId);
+}
+
+template<int taskId> struct simTaskFuncTable
+{
+    static void fill(void (**table)(timeUs_t))
+    {
+        table[taskId - 1] = simTaskFunc<taskId - 1>;
+        simTaskFuncTable<taskId - 1>::fill(table);
+    }
+};
+
+template<> struct simTaskFuncTable<0>
+{
+    static void fill(void (**table)(timeUs_t))
+    {
+        (void)table;
+    }
+};
+
+Simulation::Simulation(Scheduler &scheduler, task_t *taskTable, int taskCount)
+    : scheduler(scheduler), taskTable(taskTable), taskCount(taskCount < SIM_MAX_TASKS ? taskCount : SIM_MAX_TASKS)
+{
+    static void (*taskFuncs[SIM_MAX_TASKS])(timeUs_t);
+    simTaskFuncTable<SIM_MAX_TASKS>::fill(taskFuncs);
+
+    // Tasks are enabled before run(), their first due times must be on the virtual clock too
+    hostClockUseVirtual(true);
+    memset(models, 0, sizeof(models));
+    memset(results, 0, sizeof(results));
+    for (int taskId = 0; taskId < this->taskCount; taskId++) {
+        if (taskTable[taskId].taskFunc) {
+            taskTable[taskId].taskFunc = taskFuncs[taskId];
+        }
+    }
+}
+
+void Simulation::setTaskModel(int taskId, timeDelta_t costUs, timeDelta_t costJitterUs)
+{
+    if (taskId < taskCount) {
+        models[taskId].costUs = costUs;
+        models[taskId].costJitterUs = costJitterUs;
+    }
+}
+
+void Simulation::setPassCostUs(timeDelta_t passCostUs)
+{
+    this->passCostUs = passCostUs;
+}
+
+// Idle passes sleep through the host hook, which jumps the virtual clock to the next due time
+void Simulation::setTickless(bool enabled)
+{
+    scheduler.setSleepFunc(enabled ? hostSchedulerSleep : NULL);
+}
+
+// Reports the largest task time charged in one pass and in one window of loadWindowUs
+void Simulation::setLoadWindowUs(timeDelta_t loadWindowUs)
+{
+    this->loadWindowUs = loadWindowUs;
+}
+
+// Splits the cost over the windows it spans, windows without any task count as idle
+void Simulation::addBusyTime(timeUs_t startUs, timeDelta_t costUs)
+{
+    passBusyUs += costUs;
+    if (loadWindowUs <= 0) {
+        return;
+    }
+    if (!loadWindowStarted) {
+        loadWindowStarted = true;
+        loadWindowStartUs = startUs;
+    }
+    while (costUs > 0) {
+        const timeUs_t windowEndUs = loadWindowStartUs + loadWindowUs;
+        if (cmpTimeUs(startUs, windowEndUs) >= 0) {
+            maxWindowBusyUs = MAX(maxWindowBusyUs, windowBusyUs);
+            windowBusyUs = 0;
+            loadWindowStartUs += (cmpTimeUs(startUs, loadWindowStartUs) / loadWindowUs) * loadWindowUs;
+            continue;
+        }
+        const timeDelta_t partUs = MIN(costUs, cmpTimeUs(windowEndUs, startUs));
+        windowBusyUs += partUs;
+        startUs += partUs;
+        costUs -= partUs;
+    }
+}
+
+const simTaskResult_t *Simulation::getTaskResult(int taskId)
+{
+    return &results[taskId];
+}
+
+void Simulation::recordTaskStart(int taskId)
+{
+    const task_t *task = &taskTable[taskId];
+    simTaskResult_t *result = &results[taskId];
+    const timeUs_t startUs = micros();
+
+    if (result->runs > 0) {
+        const timeDelta_t periodUs = scheduler.getTaskPeriodUs((taskId_e)taskId);
+        const timeDelta_t deltaUs = cmpTimeUs(startUs, result->lastStartUs);
+        const timeDelta_t jitterUs = deltaUs - periodUs;
+        result->sumDeltaUs += deltaUs;
+        result->sumSquaredJitterUs += (int64_t)jitterUs * jitterUs;
+        result->maxJitterUs = MAX(result->maxJitterUs, jitterUs < 0 ? -jitterUs : jitterUs);
+        if (!task->checkFunc && !(task->taskFlags & TASK_FLAG_SIGNAL_DRIVEN) && deltaUs >= 2 * periodUs) {
+            result->missedPeriods += deltaUs / periodUs - 1;
+        }
+        const timeDelta_t latenessUs = MAX(0, jitterUs);
+        result->sumLatenessUs += latenessUs;
+        result->maxLatenessUs = MAX(result->maxLatenessUs, latenessUs);
+    }
+    result->lastStartUs = startUs;
+    result->runs++;
+    taskRanThisPass = true;
+
+    timeDelta_t costUs = models[taskId].costUs;
+    if (models[taskId].costJitterUs > 0) {
+        randomState = randomState * 1103515245 + 12345;
+        costUs += (randomState >> 16) % (models[taskId].costJitterUs + 1);
+    }
+    addBusyTime(startUs, costUs);
+    hostClockAdvanceUs(costUs);
+}
+
+void Simulation::run(timeUs_t durationUs)
+{
+    activeSimulation = this;
+    hostClockUseVirtual(true);
+    const timeUs_t endUs = micros() + durationUs;
+    while (cmpTimeUs(micros(), endUs) < 0) {
+        taskRanThisPass = false;
+        passBusyUs = 0;
+        const uint64_t startNs = monotonicNs();
+        scheduler.run_scheduler();
+        const uint64_t passNs = monotonicNs() - startNs;
+        overheadNs += passNs;
+        maxPassNs = MAX(maxPassNs, passNs);
+        maxPassBusyUs = MAX(maxPassBusyUs, passBusyUs);
+        passes++;
+        if (taskRanThisPass) {
+            dispatchPasses++;
+        }
+        hostClockAdvanceUs(passCostUs);
+    }
+    simulatedUs += durationUs;
+    activeSimulation = NULL;
+}
+
+void Simulation::report(const char *title)
+{
+    printf("== %s: %.3f s simulated, %llu passes (%llu dispatching), overhead %.1f ns/pass avg, %llu ns max\n",
+           title, simulatedUs / 1e6, (unsigned long long)passes, (unsigned long long)dispatchPasses,
+           passes ? (double)overheadNs / passes : 0.0, (unsigned long long)maxPassNs);
+    idleInfo_t idleInfo;
+    scheduler.getIdleInfo(&idleInfo);
+    if (idleInfo.sleepCount > 0) {
+        printf("tickless idle: %u sleeps, %.1f%% of the time asleep\n", idleInfo.sleepCount, 100.0 * idleInfo.totalSleepUs / simulatedUs);
+    }
+    if (loadWindowUs > 0) {
+        printf("task load: %d us max in one pass, %.1f%% max over %d us windows\n",
+               (int)maxPassBusyUs, 100.0 * MAX(maxWindowBusyUs, windowBusyUs) / loadWindowUs, (int)loadWindowUs);
+    }
+    printf("%-3s %-12s %9s %8s %11s %10s %10s %7s %10s %10s\n",
+           "id", "task", "period/us", "runs", "avg dt/us", "jitter/us", "max jit/us", "missed", "late/us", "max late");
+    for (int taskId = 0; taskId < taskCount; taskId++) {
+        const task_t *task = &taskTable[taskId];
+        const simTaskResult_t *result = &results[taskId];
+        if (!task->taskFunc) {
+            continue;
+        }
+        const uint32_t intervals = result->runs > 1 ? result->runs - 1 : 0;
+        printf("%-3d %-12s %9d %8u %11.1f %10.1f %10d %7u %10.1f %10d\n",
+               taskId, task->taskName, (int)scheduler.getTaskPeriodUs((taskId_e)taskId), result->runs,
+               intervals ? (double)result->sumDeltaUs / intervals : 0.0,
+               intervals ? sqrt((double)result->sumSquaredJitterUs / intervals) : 0.0,
+               (int)result->maxJitterUs, result->missedPeriods,
+               intervals ? (double)result->sumLatenessUs / intervals : 0.0,
+               (int)result->maxLatenessUs);
+    }
+#if defined(USE_TASK_HISTOGRAMS)
+    printf("%-3s %-12s %8s %8s %8s %8s %10s %10s %10s\n", "id", "task", "exec p50", "p90", "p99", "max", "late p50", "p90", "p99");
+    for (int taskId = 0; taskId < taskCount; taskId++) {
+        taskHistogramInfo_t histogramInfo;
+        if (!taskTable[taskId].taskFunc) {
+            continue;
+        }
+        scheduler.getTaskHistogramInfo((taskId_e)taskId, &histogramInfo);
+        printf("%-3d %-12s %8u %8u %8u %8u %10u %10u %10u\n", taskId, taskTable[taskId].taskName,
+               (unsigned)histogramInfo.executionTime.p50Us, (unsigned)histogramInfo.executionTime.p90Us,
+               (unsigned)histogramInfo.executionTime.p99Us, (unsigned)histogramInfo.executionTime.maxUs,
+               (unsigned)histogramInfo.startLateness.p50Us, (unsigned)histogramInfo.startLateness.p90Us,
+               (unsigned)histogramInfo.startLateness.p99Us);
+    }
+#endif
+}
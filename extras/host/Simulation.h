@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ * Deterministic replay of a task set on the host. Task bodies are replaced by
+ * models that charge a fixed cost to the virtual clock, so every run of the
+ * same task set produces the same schedule. The real time spent inside
+ * run_scheduler() is measured separately as the scheduler overhead.
+ */
+
+#include "Scheduler.h"
+#include "HostClock.h"
+#include "HostSleep.h"
+
+#define SIM_MAX_TASKS 128
+
+typedef struct {
+    timeDelta_t costUs;             // execution time charged to the virtual clock
+    timeDelta_t costJitterUs;       // extra pseudo random cost, 0..costJitterUs
+} simTaskModel_t;
+
+typedef struct {
+    uint32_t runs;
+    timeUs_t lastStartUs;
+    int64_t  sumDeltaUs;            // sum of start to start intervals
+    int64_t  sumSquaredJitterUs;    // sum of (interval - period)^2
+    timeDelta_t maxJitterUs;        // largest |interval - period|
+    uint32_t missedPeriods;         // whole periods that passed without a run
+    int64_t  sumLatenessUs;         // start time after the due time
+    timeDelta_t maxLatenessUs;
+} simTaskResult_t;
+
+class Simulation
+{
+    public:
+        Simulation(Scheduler &scheduler, task_t *taskTable, int taskCount);
+        void setTaskModel(int taskId, timeDelta_t costUs, timeDelta_t costJitterUs = 0);
+        void setPassCostUs(timeDelta_t passCostUs);
+        void setTickless(bool enabled);
+        void setLoadWindowUs(timeDelta_t loadWindowUs);
+        void run(timeUs_t durationUs);
+        void report(const char *title);
+        const simTaskResult_t *getTaskResult(int taskId);
+        void recordTaskStart(int taskId);
+    private:
+        Scheduler &scheduler;
+        task_t *taskTable;
+        int taskCount;
+        timeDelta_t passCostUs = 1;
+        uint32_t randomState = 1;
+        simTaskModel_t models[SIM_MAX_TASKS];
+        simTaskResult_t results[SIM_MAX_TASKS];
+        uint64_t passes = 0;
+        uint64_t dispatchPasses = 0;
+        uint64_t overheadNs = 0;
+        uint64_t maxPassNs = 0;
+        timeUs_t simulatedUs = 0;
+        void addBusyTime(timeUs_t startUs, timeDelta_t costUs);
+        timeDelta_t loadWindowUs = 0;   // 0 leaves the load out of the report
+        timeUs_t loadWindowStartUs = 0;
+        bool loadWindowStarted = false;
+        timeDelta_t windowBusyUs = 0;
+        timeDelta_t maxWindowBusyUs = 0;
+        timeDelta_t passBusyUs = 0;
+        timeDelta_t maxPassBusyUs = 0;
+};
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""
+Decodes statistics frames written by Scheduler::takeSnapshot() and
+streamSnapshot() and prints them as the Scheduler::printTasks() table.
+
+    snapshot2table.py capture.bin           # newest complete frame
+    snapshot2table.py --all capture.bin     # every complete frame, oldest first
+    cat /dev/ttyACM0 > capture.bin          # one way to capture them
+
+The input may be a raw serial capture with text around the frames, they are
+found by their "SSNP" magic. Frames with a bad checksum are skipped, a capture
+"-" is read from stdin.
+"""
+
+import struct
+import sys
+
+MAGIC = b"SSNP"
+VERSION = 1
+HEADER = struct.Struct("<4sBBBBIIHHIIIHBB")
+TASK = struct.Struct("<HbBiIIIIiiIi")
+
+FLAG_TRUNCATED = 1 << 0
+FLAG_LOAD_ACCOUNTING = 1 << 2
+
+
+def parse_frame(data, offset):
+    """Returns the frame at offset as a dict, None if it is cut short or damaged"""
+    if offset + HEADER.size > len(data):
+        return None
+    (magic, version, flags, record_size, record_count, sequence, time_us, frame_bytes, checksum,
+     cf_max_us, cf_average_us, cf_total_us, system_load, cpu_load, overhead) = HEADER.unpack_from(data, offset)
+    if magic != MAGIC or version != VERSION or record_size != TASK.size:
+        return None
+    if frame_bytes < HEADER.size + record_count * TASK.size or offset + frame_bytes > len(data):
+        return None
+    frame = bytearray(data[offset:offset + frame_bytes])
+    frame[18:20] = b"\0\0"
+    if sum(frame) & 0xFFFF != checksum:
+        return None
+
+    pos = offset + HEADER.size
+    tasks = [TASK.unpack_from(data, pos + ii * TASK.size) for ii in range(record_count)]
+    pos += record_count * TASK.size
+    names = []
+    for _ in range(record_count):
+        end = data.find(b"\0", pos, offset + frame_bytes)
+        if end < 0:
+            return None
+        names.append(data[pos:end].decode("ascii", "replace"))
+        pos = end + 1
+    return {
+        "flags": flags, "sequence": sequence, "time_us": time_us, "system_load": system_load,
+        "cpu_load": cpu_load, "overhead": overhead,
+        "check_func": (cf_max_us, cf_average_us, cf_total_us),
+        "tasks": list(zip(names, tasks)), "bytes": frame_bytes,
+    }
+
+
+def find_frames(data):
+    frames = []
+    offset = data.find(MAGIC)
+    while offset >= 0:
+        frame = parse_frame(data, offset)
+        if frame:
+            frames.append(frame)
+            offset = data.find(MAGIC, offset + frame["bytes"])
+        else:
+            offset = data.find(MAGIC, offset + 1)
+    return frames
+
+
+def print_table(frame, out):
+    """Same columns and rounding as Scheduler::printTasks()"""
+    out.write("Snapshot %d at %.3f s\n" % (frame["sequence"], frame["time_us"] / 1e6))
+    out.write("Task list             rate/hz  max/us  avg/us maxload avgload  total/ms\n")
+    max_load_sum = 0
+    average_load_sum = 0
+    for name, task in frame["tasks"]:
+        (task_id, _priority, _flags, _period_us, max_us, average_us, average_delta_us, total_us,
+         _latest_delta_us, _max_signal_latency_us, _late_count, _max_lateness_us) = task
+        frequency = 0 if average_delta_us == 0 else (1000000 + average_delta_us // 2) // average_delta_us
+        max_load = 0 if max_us == 0 else (max_us * frequency + 5000) // 1000
+        average_load = 0 if average_us == 0 else (average_us * frequency + 5000) // 1000
+        max_load_sum += max_load
+        average_load_sum += average_load
+        out.write("%02d - (%15s) %6d %7d %7d %4d.%1d%% %4d.%1d%% %9d\n" % (
+            task_id, name, frequency, max_us, average_us,
+            max_load // 10, max_load % 10, average_load // 10, average_load % 10, total_us // 1000))
+    cf_max_us, cf_average_us, cf_total_us = frame["check_func"]
+    out.write("Check Function %19d %7d %25d\n" % (cf_max_us, cf_average_us, cf_total_us // 1000))
+    out.write("Total%25d.%1d%% %4d.%1d%%\n" % (
+        max_load_sum // 10, max_load_sum % 10, average_load_sum // 10, average_load_sum % 10))
+    if frame["flags"] & FLAG_LOAD_ACCOUNTING:
+        out.write("CPU load %d%%, scheduler overhead %d%%\n" % (frame["cpu_load"], frame["overhead"]))
+    if frame["flags"] & FLAG_TRUNCATED:
+        out.write("(more tasks enabled than fitted into the frame)\n")
+
+
+def main():
+    args = sys.argv[1:]
+    show_all = "--all" in args
+    args = [arg for arg in args if arg != "--all"]
+    if len(args) != 1:
+        sys.stderr.write("usage: snapshot2table.py [--all] capture.bin\n")
+        return 2
+    if args[0] == "-":
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args[0], "rb") as capture:
+            data = capture.read()
+    frames = find_frames(data)
+    if not frames:
+        sys.stderr.write("no complete snapshot frame in %s\n" % args[0])
+        return 1
+    for frame in frames if show_all else frames[-1:]:
+        print_table(frame, sys.stdout)
+    sys.stderr.write("%d frames\n" % len(frames))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
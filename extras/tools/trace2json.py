@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""
+Converts a trace blob written by Scheduler::dumpTrace() into Chrome trace /
+Perfetto JSON, open the result in https://ui.perfetto.dev or chrome://tracing.
+
+    trace2json.py capture.bin > trace.json
+
+The input may be a raw serial capture, the blob is found by its "STRC" magic
+and the last complete one is used. Task runs and checkFunc polls become spans,
+signals and realtime deadline misses instant events. Every thread that
+recorded events gets a track of its own, with USE_SCHEDULER_EXECUTOR tasks run
+on several at once.
+"""
+
+import json
+import struct
+import sys
+
+MAGIC = b"STRC"
+VERSIONS = (1, 2)  # version 1 has no thread in the event type
+HEADER = struct.Struct("<4sBBHH")
+EVENT = struct.Struct("<IBBH")
+NO_TASK = 0xFF
+TYPE_MASK = 0x0F
+THREAD_SHIFT = 4
+OTHER_THREAD = 0x0F
+
+TASK_START, TASK_END, CHECK_START, CHECK_END, SIGNAL, DEADLINE_MISS = range(6)
+
+
+def parse_blob(data, offset):
+    """Returns (names, events) for the blob at offset, None if it is cut short"""
+    magic, version, event_size, name_count, event_count = HEADER.unpack_from(data, offset)
+    if magic != MAGIC or version not in VERSIONS or event_size != EVENT.size:
+        return None
+    pos = offset + HEADER.size
+    names = []
+    for _ in range(name_count):
+        end = data.find(b"\0", pos)
+        if end < 0:
+            return None
+        names.append(data[pos:end].decode("ascii", "replace"))
+        pos = end + 1
+    if pos + event_count * EVENT.size > len(data):
+        return None
+    events = [EVENT.unpack_from(data, pos + ii * EVENT.size) for ii in range(event_count)]
+    return names, events
+
+
+def find_blob(data):
+    offset = data.rfind(MAGIC)
+    while offset >= 0:
+        if offset + HEADER.size <= len(data):
+            blob = parse_blob(data, offset)
+            if blob:
+                return blob
+        offset = data.rfind(MAGIC, 0, offset)
+    return None
+
+
+def to_chrome_trace(names, events):
+    def name(task_index):
+        if task_index == NO_TASK or task_index >= len(names):
+            return "task %d" % task_index
+        return names[task_index] or "task %d" % task_index
+
+    def thread_name(tid):
+        if tid == 0:
+            return "scheduler"
+        return "other" if tid == OTHER_THREAD else "worker %d" % tid
+
+    trace = [{"ph": "M", "pid": 0, "tid": 0, "name": "process_name", "args": {"name": "scheduler"}}]
+    # Timestamps are 32 bit microseconds, unwrap them
+    base = 0
+    last = None
+    open_spans = {}  # per thread, an end closes the newest span its own thread opened
+    for time_us, event_type, task_index, arg in events:
+        if last is not None and time_us < last and last - time_us > 0x80000000:
+            base += 1 << 32
+        last = time_us
+        ts = base + time_us
+        tid = event_type >> THREAD_SHIFT
+        event_type &= TYPE_MASK
+        if tid not in open_spans:
+            open_spans[tid] = []
+            trace.append({"ph": "M", "pid": 0, "tid": tid, "name": "thread_name", "args": {"name": thread_name(tid)}})
+        if event_type in (TASK_START, CHECK_START):
+            span = name(task_index) if event_type == TASK_START else name(task_index) + " checkFunc"
+            # The ring may start halfway through a span, its end is dropped below
+            open_spans[tid].append(span)
+            trace.append({"ph": "B", "pid": 0, "tid": tid, "ts": ts, "name": span,
+                          "cat": "task" if event_type == TASK_START else "checkFunc"})
+        elif event_type in (TASK_END, CHECK_END):
+            if not open_spans[tid]:
+                continue
+            open_spans[tid].pop()
+            end = {"ph": "E", "pid": 0, "tid": tid, "ts": ts}
+            if event_type == CHECK_END:
+                end["args"] = {"ready": bool(arg)}
+            trace.append(end)
+        elif event_type == SIGNAL:
+            trace.append({"ph": "i", "pid": 0, "tid": tid, "ts": ts, "s": "t", "name": "signal " + name(task_index)})
+        elif event_type == DEADLINE_MISS:
+            trace.append({"ph": "i", "pid": 0, "tid": tid, "ts": ts, "s": "g", "name": "deadline miss " + name(task_index),
+                          "args": {"latenessUs": arg}})
+    return {"traceEvents": trace, "displayTimeUnit": "ns"}
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.stderr.write("usage: trace2json.py capture.bin > trace.json\n")
+        return 2
+    with open(sys.argv[1], "rb") as capture:
+        data = capture.read()
+    blob = find_blob(data)
+    if not blob:
+        sys.stderr.write("no complete trace blob in %s\n" % sys.argv[1])
+        return 1
+    names, events = blob
+    json.dump(to_chrome_trace(names, events), sys.stdout, indent=None, separators=(",", ":"))
+    sys.stdout.write("\n")
+    sys.stderr.write("%d events, %d tasks\n" % (len(events), len(names)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,178 +1,1547 @@
 #include "Scheduler.h"
+#include "SchedulerPolicy.h"
 #include <stdio.h>
 #include <string.h>
+#if defined(USE_SCHEDULER_TASK_POOL)
+#include <new>
+#endif
 
 
 #define TASK_AVERAGE_EXECUTE_FALLBACK_US 30 // Default task average time if USE_TASK_STATISTICS is not defined
 #define TASK_AVERAGE_EXECUTE_PADDING_US 5   // Add a little padding to the average execution time
 
-#if defined(USE_TASK_STATISTICS)
-timeUs_t checkFuncMaxExecutionTimeUs;
-timeUs_t checkFuncTotalExecutionTimeUs;
-timeUs_t checkFuncMovingSumExecutionTimeUs;
-timeUs_t checkFuncMovingSumDeltaTimeUs;
+// Weak so that sketches built only on StaticScheduler link without a task table
+extern task_t tasks[TASK_COUNT] __attribute__((weak));
+
+static const int periodCalculationBasisOffset = offsetof(taskState_t, lastExecutedAtUs);
+
+#if defined(USE_SCHEDULER_EXECUTOR)
+// Only its address is used, it tells the threads running tasks apart
+static thread_local char threadKey;
 #endif
 
-task_t* taskQueueArray[TASK_COUNT + 1]; // extra item for NULL pointer at end of queue
-static int taskQueuePos = 0;
-int taskQueueSize = 0;
-static task_t *currentTask = NULL;
-static bool calculateTaskStatistics = true;
-uint16_t averageSystemLoadPercent = 0;
-static int periodCalculationBasisOffset = offsetof(task_t, lastExecutedAtUs);
 
+inline static timeUs_t getPeriodCalculationBasis(const task_t* task, const taskState_t *state)
+{
+#if defined(USE_SCHEDULER_ANCHORED_TIMING)
+    // Anchored tasks are due a period after the last release they served
+    if (state->timing != TASK_TIMING_RELATIVE) {
+        return state->lastDesiredAt;
+    }
+#endif
+    if (task->staticPriority == TASK_PRIORITY_REALTIME) {
+        return *(timeUs_t*)((uint8_t*)state + periodCalculationBasisOffset);
+    } else {
+        return state->lastExecutedAtUs;
+    }
+}
 
-static uint32_t totalWaitingTasks;
-static uint32_t totalWaitingTasksSamples;
+inline static bool isEventDriven(const task_t* task)
+{
+    return task->checkFunc || (task->taskFlags & TASK_FLAG_SIGNAL_DRIVEN);
+}
 
+inline static bool isTimeDriven(const task_t* task)
+{
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+    if (task->resumeFunc) {
+        return false;
+    }
+#endif
+    return !isEventDriven(task);
+}
+
+// An in-flight task belongs to the executor until it is collected, the scheduler must not touch it
+inline static bool isInFlight(const taskState_t *state)
+{
+#if defined(USE_SCHEDULER_EXECUTOR)
+    return state->inFlight;
+#else
+    (void)state;
+    return false;
+#endif
+}
 
-Scheduler::Scheduler() {
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+// A resumable task between runs is due a period after its last run started, during a run at resumeAtUs
+inline static timeUs_t resumableDueAtUs(const taskState_t *state)
+{
+    return state->coroutine.resumePoint ? state->coroutine.resumeAtUs : state->coroutine.runStartedAtUs + state->desiredPeriodUs;
+}
+#endif
+
+// Only worked out for policies ranking by deadline, a period is the relative deadline
+inline static timeUs_t getTaskDeadlineUs(const task_t* task, const taskState_t *state)
+{
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+    if (task->resumeFunc) {
+        return resumableDueAtUs(state) + state->desiredPeriodUs;
+    }
+#endif
+    if (isEventDriven(task)) {
+        return state->lastSignaledAtUs + state->desiredPeriodUs;
+    }
+    // lastDesiredAt is the start of the last period run in, the task is due at the start of the next one
+    return state->lastDesiredAt + 2 * state->desiredPeriodUs;
+}
+
+inline static uint32_t getTaskRank(const task_t* task, const taskState_t *state, timeUs_t currentTimeUs)
+{
+    return SchedulerPolicy::rank(state->dynamicPriority, task->staticPriority, state->desiredPeriodUs,
+                                 SchedulerPolicy::usesDeadline ? getTaskDeadlineUs(task, state) : 0, currentTimeUs);
+}
+
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+// Tasks the governor measures and stretches, all others are protected
+inline static bool isStretchable(const task_t* task)
+{
+    return task->staticPriority >= TASK_PRIORITY_IDLE && task->staticPriority <= SCHEDULER_OVERLOAD_STRETCH_PRIORITY && !isEventDriven(task);
+}
+#endif
+
+#if defined(USE_SCHEDULER_ANCHORED_TIMING)
+/*
+ * Moves lastDesiredAt to the release a time-driven task is about to serve and
+ * counts what was missed. All differences are taken unsigned, so they stay
+ * right across the wrap of a 32-bit clock and with USE_64BIT_TIME.
+ */
+static void advanceRelease(taskState_t *state, timeUs_t currentTimeUs)
+{
+    const timeUs_t periodUs = state->desiredPeriodUs;
+    if (state->timing == TASK_TIMING_RELATIVE) {
+        // The next run is due a period after this one, so any lateness now shifts all later runs
+        const timeUs_t sinceLastUs = currentTimeUs - state->lastExecutedAtUs;
+        if (sinceLastUs > periodUs) {
+            state->accumulatedDriftUs += sinceLastUs - periodUs;
+            state->missedReleases += (sinceLastUs - periodUs) / periodUs;
+        }
+        state->lastDesiredAt += ((timeUs_t)(currentTimeUs - state->lastDesiredAt) / periodUs) * periodUs;
+        return;
+    }
+    // Releases on the grid that are due by now, this run serves the oldest one kept
+    const timeUs_t dueReleases = (timeUs_t)(currentTimeUs - state->lastDesiredAt) / periodUs;
+    if (dueReleases == 0) {
+        return;
+    }
+    const timeUs_t keptReleases = state->timing == TASK_TIMING_CATCH_UP ? MIN(dueReleases, (timeUs_t)state->catchUpLimit + 1) : 1;
+    state->missedReleases += dueReleases - keptReleases;
+    state->lastDesiredAt += (dueReleases - keptReleases + 1) * periodUs;
+}
+#endif
+
+/*
+ * A scheduler owns all of its state, so several can run side by side, one per
+ * core or thread, each on its own task table of at most TASK_COUNT tasks
+ */
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+Scheduler::Scheduler(const task_t *taskTable, int taskCount)
+    // Never written through, the configuration of pool tasks lives in taskPool
+    : taskTable(const_cast<task_t *>(taskTable)), taskCount(MIN(taskCount, (int)TASK_COUNT))
+{
+    resetTaskStates();
+#else
+Scheduler::Scheduler(task_t *taskTable, int taskCount)
+    : taskTable(taskTable), taskCount(MIN(taskCount, (int)TASK_COUNT))
+{
+#endif
+#if defined(USE_SCHEDULER_TASK_POOL)
+    poolReset();
+#endif
+}
 
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+/*
+ * The split layout keeps the state and the statistics of every task here, they
+ * start over from the configuration in the task table. The constructor does it
+ * for a table that is set up in advance, a table filled in later needs a call
+ * of its own before the tasks are configured and enabled.
+ */
+void Scheduler::resetTaskStates(void)
+{
+    memset(taskStates, 0, sizeof(taskStates));
+    for (int taskId = 0; taskId < taskCount; taskId++) {
+        taskStates[taskId].desiredPeriodUs = taskTable[taskId].desiredPeriodUs;
+    }
+#if defined(USE_TASK_STATISTICS)
+    memset(taskStatisticsTable, 0, sizeof(taskStatisticsTable));
+#endif
 }
+#endif
 
 void Scheduler::queueClear(void)
 {
+    SCHEDULER_LOCK();
+#if defined(USE_SCHEDULER_TASK_POOL)
+    poolReset();
+#endif
+    for (int ii = 0; ii < taskQueueSize; ++ii) {
+        taskState(taskQueueArray[ii])->isQueued = false;
+    }
     memset(taskQueueArray, 0, sizeof(taskQueueArray));
     taskQueuePos = 0;
     taskQueueSize = 0;
+    realtimeQueueSize = 0;
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+    taskHeapSize = 0;
+    taskEventSize = 0;
+#endif
 }
 
 bool Scheduler::queueContains(task_t *task)
 {
+    return taskState(task)->isQueued;
+}
+
+bool Scheduler::queueAdd(task_t *task)
+{
+    taskState_t *state = taskState(task);
+    SCHEDULER_LOCK();
+    if ((taskQueueSize >= SCHEDULER_QUEUE_CAPACITY) || queueContains(task)) {
+        return false;
+    }
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+    // The heap and the event list select the tasks, the queue only holds them and takes them at its end
+    state->queueIndex = taskQueueSize;
+    taskQueueArray[taskQueueSize++] = task;
+    state->isQueued = true;
+    // Realtime tasks only run in the realtime lane, a checkFunc doesn't make them background events
+    if (task->staticPriority == TASK_PRIORITY_REALTIME) {
+        // Added by a task of the lane, it still gets a turn in this pass
+        state->realtimeRanThisPass = false;
+        realtimeQueueArray[realtimeQueueSize++] = task;
+    } else if (isEventDriven(task)
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+        || task->resumeFunc
+#endif
+        ) {
+        taskEventArray[taskEventSize++] = task;
+    } else {
+        heapInsert(task, micros());
+    }
+    return true;
+#else
+    for (int ii = 0; ii <= taskQueueSize; ++ii) {
+        if (taskQueueArray[ii] == NULL || taskQueueArray[ii]->staticPriority < task->staticPriority) {
+            memmove(&taskQueueArray[ii+1], &taskQueueArray[ii], sizeof(task) * (taskQueueSize - ii));
+            taskQueueArray[ii] = task;
+            state->isQueued = true;
+            ++taskQueueSize;
+            if (task->staticPriority == TASK_PRIORITY_REALTIME) {
+                // Added by a task of the lane, it still gets a turn in this pass
+                state->realtimeRanThisPass = false;
+                realtimeQueueArray[realtimeQueueSize++] = task;
+            }
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+            memmove(&taskQueueBasisUs[ii+1], &taskQueueBasisUs[ii], sizeof(taskQueueBasisUs[0]) * (taskQueueSize - 1 - ii));
+            memmove(&taskQueuePeriodUs[ii+1], &taskQueuePeriodUs[ii], sizeof(taskQueuePeriodUs[0]) * (taskQueueSize - 1 - ii));
+            queueRenumber(ii);
+            queueUpdateDue(task);
+#endif
+            return true;
+        }
+    }
+    return false;
+#endif
+}
+
+void Scheduler::realtimeQueueRemove(task_t *task)
+{
+    if (task->staticPriority != TASK_PRIORITY_REALTIME) {
+        return;
+    }
+    for (int ii = 0; ii < realtimeQueueSize; ++ii) {
+        if (realtimeQueueArray[ii] == task) {
+            realtimeQueueArray[ii] = realtimeQueueArray[--realtimeQueueSize];
+            return;
+        }
+    }
+}
+
+bool Scheduler::queueRemove(task_t *task)
+{
+    taskState_t *state = taskState(task);
+    SCHEDULER_LOCK();
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+    if (!queueContains(task)) {
+        return false;
+    }
+    // The queue is in no particular order, the last task fills the gap
+    task_t *lastTask = taskQueueArray[--taskQueueSize];
+    taskQueueArray[state->queueIndex] = lastTask;
+    taskState(lastTask)->queueIndex = state->queueIndex;
+    taskQueueArray[taskQueueSize] = NULL;
+    state->isQueued = false;
+    realtimeQueueRemove(task);
+    if (heapContains(task)) {
+        heapRemove(task);
+    } else {
+        for (int ii = 0; ii < taskEventSize; ++ii) {
+            if (taskEventArray[ii] == task) {
+                taskEventArray[ii] = taskEventArray[--taskEventSize];
+                break;
+            }
+        }
+    }
+    return true;
+#else
     for (int ii = 0; ii < taskQueueSize; ++ii) {
         if (taskQueueArray[ii] == task) {
+            memmove(&taskQueueArray[ii], &taskQueueArray[ii+1], sizeof(task) * (taskQueueSize - ii));
+            state->isQueued = false;
+            --taskQueueSize;
+            realtimeQueueRemove(task);
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+            memmove(&taskQueueBasisUs[ii], &taskQueueBasisUs[ii+1], sizeof(taskQueueBasisUs[0]) * (taskQueueSize - ii));
+            memmove(&taskQueuePeriodUs[ii], &taskQueuePeriodUs[ii+1], sizeof(taskQueuePeriodUs[0]) * (taskQueueSize - ii));
+            queueRenumber(ii);
+#endif
             return true;
         }
     }
-    return false;
+    return false;
+#endif
+}
+
+/*
+ * Returns first item queue or NULL if queue empty
+ */
+task_t* Scheduler::queueFirst(void)
+{
+    taskQueuePos = 0;
+    return taskQueueArray[0]; // guaranteed to be NULL if queue is empty
+}
+
+/*
+ * Returns next item in queue or NULL if at end of queue
+ */
+task_t* Scheduler::queueNext(void)
+{
+    return taskQueueArray[++taskQueuePos]; // guaranteed to be NULL at end of queue
+}
+
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+/*
+ * Min-heap of time-driven tasks ordered by nextDueAtUs. Every task keeps its
+ * own heapIndex so that removal and re-keying are O(log n).
+ */
+bool Scheduler::heapContains(const task_t *task)
+{
+    const taskState_t *state = taskState(task);
+    return state->heapIndex >= 0 && state->heapIndex < taskHeapSize && taskHeapArray[state->heapIndex] == task;
+}
+
+void Scheduler::heapSwap(int a, int b)
+{
+    task_t *task = taskHeapArray[a];
+    taskHeapArray[a] = taskHeapArray[b];
+    taskHeapArray[b] = task;
+    taskState(taskHeapArray[a])->heapIndex = a;
+    taskState(taskHeapArray[b])->heapIndex = b;
+}
+
+void Scheduler::heapSiftUp(int index)
+{
+    while (index > 0) {
+        const int parent = (index - 1) / 2;
+        if (cmpTimeUs(taskState(taskHeapArray[index])->nextDueAtUs, taskState(taskHeapArray[parent])->nextDueAtUs) >= 0) {
+            break;
+        }
+        heapSwap(index, parent);
+        index = parent;
+    }
+}
+
+void Scheduler::heapSiftDown(int index)
+{
+    for (;;) {
+        const int left = 2 * index + 1;
+        const int right = left + 1;
+        int smallest = index;
+        if (left < taskHeapSize && cmpTimeUs(taskState(taskHeapArray[left])->nextDueAtUs, taskState(taskHeapArray[smallest])->nextDueAtUs) < 0) {
+            smallest = left;
+        }
+        if (right < taskHeapSize && cmpTimeUs(taskState(taskHeapArray[right])->nextDueAtUs, taskState(taskHeapArray[smallest])->nextDueAtUs) < 0) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        heapSwap(index, smallest);
+        index = smallest;
+    }
+}
+
+void Scheduler::heapInsert(task_t *task, timeUs_t currentTimeUs)
+{
+    taskState_t *state = taskState(task);
+    if (heapContains(task) || taskHeapSize >= SCHEDULER_QUEUE_CAPACITY) {
+        return;
+    }
+    state->nextDueAtUs = getPeriodCalculationBasis(task, state) + state->desiredPeriodUs;
+    // A task that sat disabled for more than half the timer range looks like it is due in the future, make it due now
+    if (cmpTimeUs(state->nextDueAtUs, currentTimeUs) > state->desiredPeriodUs) {
+        state->nextDueAtUs = currentTimeUs;
+    }
+    state->heapIndex = taskHeapSize;
+    taskHeapArray[taskHeapSize++] = task;
+    heapSiftUp(state->heapIndex);
+}
+
+void Scheduler::heapRemove(task_t *task)
+{
+    taskState_t *state = taskState(task);
+    if (!heapContains(task)) {
+        return;
+    }
+    const int index = state->heapIndex;
+    state->heapIndex = -1;
+    if (index == --taskHeapSize) {
+        return;
+    }
+    taskHeapArray[index] = taskHeapArray[taskHeapSize];
+    taskState(taskHeapArray[index])->heapIndex = index;
+    heapSiftUp(index);
+    heapSiftDown(taskState(taskHeapArray[index])->heapIndex);
+}
+
+void Scheduler::heapUpdate(task_t *task)
+{
+    taskState_t *state = taskState(task);
+    if (!heapContains(task)) {
+        return;
+    }
+    state->nextDueAtUs = getPeriodCalculationBasis(task, state) + state->desiredPeriodUs;
+    heapSiftUp(state->heapIndex);
+    heapSiftDown(state->heapIndex);
+}
+
+/*
+ * Visits only the due part of the heap, which is a subtree hanging off the root,
+ * and applies the same dynamic priority aging as the linear scan
+ */
+void Scheduler::heapSelectDue(int index, timeUs_t currentTimeUs, task_t **selectedTask, uint32_t *selectedTaskRank, uint16_t *waitingTasks)
+{
+    if (index >= taskHeapSize) {
+        return;
+    }
+    task_t *task = taskHeapArray[index];
+    taskState_t *state = taskState(task);
+    const timeDelta_t overdueUs = cmpTimeUs(currentTimeUs, state->nextDueAtUs);
+    if (overdueUs < 0) {
+        return;
+    }
+    if (!isInFlight(state)) {
+        // Age is 1 + overdue periods, skip the divide for the common case of a task less than a period late
+        state->taskAgeCycles = overdueUs < state->desiredPeriodUs ? 1 : 1 + overdueUs / state->desiredPeriodUs;
+        state->dynamicPriority = 1 + task->staticPriority * state->taskAgeCycles;
+        (*waitingTasks)++;
+        const uint32_t rank = getTaskRank(task, state, currentTimeUs);
+        if (rank > *selectedTaskRank) {
+            *selectedTaskRank = rank;
+            *selectedTask = task;
+        }
+    }
+    heapSelectDue(2 * index + 1, currentTimeUs, selectedTask, selectedTaskRank, waitingTasks);
+    heapSelectDue(2 * index + 2, currentTimeUs, selectedTask, selectedTaskRank, waitingTasks);
+}
+#elif defined(USE_SCHEDULER_SPLIT_TASKS)
+/*
+ * The queue keeps the period calculation basis and the period of every task in
+ * two arrays of its own, in queue order. A pass reads them front to back and
+ * only touches the configuration and the state of a task that is due, like the heap does for the
+ * time-driven tasks but without giving up the order of the linear scan.
+ */
+void Scheduler::queueRenumber(int index)
+{
+    for (int ii = index; ii < taskQueueSize; ++ii) {
+        taskState(taskQueueArray[ii])->queueIndex = ii;
+    }
+}
+
+// Call whenever the basis or the period of a queued task changed
+void Scheduler::queueUpdateDue(task_t *task)
+{
+    taskState_t *state = taskState(task);
+    if (!state->isQueued) {
+        return;
+    }
+    taskQueueBasisUs[state->queueIndex] = getPeriodCalculationBasis(task, state);
+    // Event-driven and resumable tasks get 0, so they count as due on every pass
+    taskQueuePeriodUs[state->queueIndex] = isTimeDriven(task) ? state->desiredPeriodUs : 0;
+}
+#endif
+
+task_t* Scheduler::getTask(unsigned taskId)
+{
+    return &taskTable[taskId];
+}
+
+#if defined(USE_TASK_HISTOGRAMS)
+/*
+ * Log-linear buckets: values below 2^SUB_BUCKET_BITS get a bucket each, above that
+ * every power of two is split into 2^SUB_BUCKET_BITS equal buckets
+ */
+static uint8_t taskHistogramBucket(timeUs_t valueUs)
+{
+    const uint32_t value = MIN(valueUs, (timeUs_t)((1UL << TASK_HISTOGRAM_MAX_BITS) - 1));
+    if (value < (1UL << TASK_HISTOGRAM_SUB_BUCKET_BITS)) {
+        return value;
+    }
+    const uint8_t exponent = (sizeof(unsigned long) * 8 - 1) - __builtin_clzl(value);
+    const uint8_t subBucket = (value >> (exponent - TASK_HISTOGRAM_SUB_BUCKET_BITS)) & ((1 << TASK_HISTOGRAM_SUB_BUCKET_BITS) - 1);
+    return ((exponent - TASK_HISTOGRAM_SUB_BUCKET_BITS + 1) << TASK_HISTOGRAM_SUB_BUCKET_BITS) + subBucket;
+}
+
+static timeUs_t taskHistogramBucketUpperUs(uint8_t bucket)
+{
+    if (bucket < (1 << TASK_HISTOGRAM_SUB_BUCKET_BITS)) {
+        return bucket;
+    }
+    const uint8_t shift = (bucket >> TASK_HISTOGRAM_SUB_BUCKET_BITS) - 1;
+    const uint32_t lower = (uint32_t)((1 << TASK_HISTOGRAM_SUB_BUCKET_BITS) | (bucket & ((1 << TASK_HISTOGRAM_SUB_BUCKET_BITS) - 1))) << shift;
+    return lower + (1UL << shift) - 1;
+}
+
+static void taskHistogramAdd(taskHistogram_t *histogram, timeUs_t valueUs)
+{
+    const uint8_t bucket = taskHistogramBucket(valueUs);
+    if (histogram->bucket[bucket] == UINT16_MAX) {
+        // Halve every bucket so the shape is kept and older samples fade out
+        histogram->samples = 0;
+        for (int ii = 0; ii < TASK_HISTOGRAM_BUCKETS; ii++) {
+            histogram->bucket[ii] >>= 1;
+            histogram->samples += histogram->bucket[ii];
+        }
+    }
+    histogram->bucket[bucket]++;
+    histogram->samples++;
+    histogram->maxValueUs = MAX(histogram->maxValueUs, valueUs);
+}
+
+static timeUs_t taskHistogramPercentile(const taskHistogram_t *histogram, uint8_t percent)
+{
+    const uint32_t target = (histogram->samples * percent + 99) / 100;
+    uint32_t count = 0;
+    for (int ii = 0; ii < TASK_HISTOGRAM_BUCKETS; ii++) {
+        count += histogram->bucket[ii];
+        if (count >= target && count > 0) {
+            return MIN(taskHistogramBucketUpperUs(ii), histogram->maxValueUs);
+        }
+    }
+    return histogram->maxValueUs;
+}
+
+static void taskHistogramPercentiles(const taskHistogram_t *histogram, taskPercentiles_t *percentiles)
+{
+    percentiles->samples = histogram->samples;
+    percentiles->p50Us = taskHistogramPercentile(histogram, 50);
+    percentiles->p90Us = taskHistogramPercentile(histogram, 90);
+    percentiles->p99Us = taskHistogramPercentile(histogram, 99);
+    percentiles->maxUs = histogram->maxValueUs;
+}
+#endif
+
+/*
+ * The task the calling thread is running, TASK_SELF. With an executor tasks run
+ * on several threads at once, so every thread gets a slot of its own the first
+ * time it runs a task of this scheduler and keeps it.
+ */
+task_t *Scheduler::getCurrentTask(void)
+{
+#if defined(USE_SCHEDULER_EXECUTOR)
+    const int slot = threadSlot();
+    return slot < 0 ? NULL : currentTasks[slot].task;
+#else
+    return currentTask;
+#endif
+}
+
+#if defined(USE_SCHEDULER_EXECUTOR)
+/*
+ * The calling thread's slot in currentTasks, -1 if it never ran a task of this scheduler
+ */
+int Scheduler::threadSlot(void) const
+{
+    for (int ii = 0; ii < SCHEDULER_EXECUTOR_THREADS; ii++) {
+        if (__atomic_load_n(&currentTasks[ii].thread, __ATOMIC_ACQUIRE) == &threadKey) {
+            return ii;
+        }
+    }
+    return -1;
+}
+#endif
+
+void Scheduler::setCurrentTask(task_t *task)
+{
+#if defined(USE_SCHEDULER_EXECUTOR)
+    for (int ii = 0; ii < SCHEDULER_EXECUTOR_THREADS; ii++) {
+        const void *thread = __atomic_load_n(&currentTasks[ii].thread, __ATOMIC_ACQUIRE);
+        if (thread == NULL && __atomic_compare_exchange_n(&currentTasks[ii].thread, &thread, (const void *)&threadKey,
+                                                          false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            thread = &threadKey;
+        }
+        if (thread == &threadKey) {
+            currentTasks[ii].task = task;
+            return;
+        }
+    }
+#else
+    currentTask = task;
+#endif
+}
+
+timeUs_t Scheduler::schedulerExecuteTask(task_t *selectedTask, timeUs_t currentTimeUs)
+{
+    taskState_t *state = taskState(selectedTask);
+    timeUs_t taskExecutionTimeUs = 0;
+
+    if (selectedTask) {
+        setCurrentTask(selectedTask);
+#if defined(USE_TASK_STATISTICS)
+        taskStatistics_t *stats = taskStatistics(selectedTask);
+#endif
+        state->taskLatestDeltaTimeUs = cmpTimeUs(currentTimeUs, state->lastExecutedAtUs);
+#if defined(USE_TASK_STATISTICS_FIXED_POINT)
+        const timeDelta_t periodQ4 = (timeDelta_t)MIN(currentTimeUs - state->lastExecutedAtUs, (timeUs_t)TASK_STATS_CYCLE_TIME_MAX_US) << TASK_STATS_CYCLE_TIME_FRACTION_BITS;
+#elif defined(USE_TASK_STATISTICS)
+        float period = currentTimeUs - state->lastExecutedAtUs;
+#endif
+#if defined(USE_TASK_HISTOGRAMS)
+        if (state->lastExecutedAtUs != 0) {
+            const timeDelta_t startLatenessUs = isEventDriven(selectedTask) ? cmpTimeUs(currentTimeUs, state->lastSignaledAtUs)
+                : cmpTimeUs(currentTimeUs, getPeriodCalculationBasis(selectedTask, state) + state->desiredPeriodUs);
+            taskHistogramAdd(&stats->startLatenessHistogram, MAX(startLatenessUs, 0));
+        }
+#endif
+#if defined(USE_SCHEDULER_ANCHORED_TIMING)
+        if (isTimeDriven(selectedTask)) {
+            advanceRelease(state, currentTimeUs);
+        } else
+#endif
+        {
+            // Unsigned difference, a task that has not run for over INT32_MAX us must not step back
+            state->lastDesiredAt += ((timeUs_t)(currentTimeUs - state->lastDesiredAt) / state->desiredPeriodUs) * state->desiredPeriodUs;
+        }
+        state->lastExecutedAtUs = currentTimeUs;
+        state->dynamicPriority = 0;
+#if defined(USE_TASK_STATISTICS)
+        if (isEventDriven(selectedTask)) {
+            stats->latestSignalLatencyUs = cmpTimeUs(currentTimeUs, state->lastSignaledAtUs);
+            stats->maxSignalLatencyUs = MAX(stats->maxSignalLatencyUs, stats->latestSignalLatencyUs);
+        }
+#endif
+
+#if defined(USE_SCHEDULER_TASK_CHAINS)
+        const bool chainTriggered = chainStart(selectedTask, currentTimeUs);
+#endif
+
+        // Execute task
+#if defined(USE_TASK_STATISTICS)
+        if (calculateTaskStatistics) {
+            const timeUs_t currentTimeBeforeTaskCallUs = micros();
+            SCHEDULER_TRACE(TRACE_TASK_START, selectedTask, currentTimeBeforeTaskCallUs, 0);
+            runTaskFunc(selectedTask, currentTimeBeforeTaskCallUs);
+            taskExecutionTimeUs = micros() - currentTimeBeforeTaskCallUs;
+            SCHEDULER_TRACE(TRACE_TASK_END, selectedTask, currentTimeBeforeTaskCallUs + taskExecutionTimeUs, 0);
+            stats->movingSumExecutionTimeUs += taskExecutionTimeUs - stats->movingSumExecutionTimeUs / TASK_STATS_MOVING_SUM_COUNT;
+            stats->movingSumDeltaTimeUs += state->taskLatestDeltaTimeUs - stats->movingSumDeltaTimeUs / TASK_STATS_MOVING_SUM_COUNT;
+            stats->totalExecutionTimeUs += taskExecutionTimeUs;   // time consumed by scheduler + task
+            stats->maxExecutionTimeUs = MAX(stats->maxExecutionTimeUs, taskExecutionTimeUs);
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+            if (state->budgetUs > 0 && (timeDelta_t)taskExecutionTimeUs > state->budgetUs) {
+                stats->budgetOverrunCount++;
+                stats->maxBudgetOverrunUs = MAX(stats->maxBudgetOverrunUs, (timeDelta_t)taskExecutionTimeUs - state->budgetUs);
+            }
+#endif
+#if defined(USE_TASK_STATISTICS_FIXED_POINT)
+            stats->movingAverageCycleTimeQ4 += (TASK_STATS_CYCLE_TIME_ALPHA * (periodQ4 - stats->movingAverageCycleTimeQ4) + 128) >> 8;
+#else
+            stats->movingAverageCycleTimeUs += 0.05f * (period - stats->movingAverageCycleTimeUs);
+#endif
+#if defined(USE_TASK_HISTOGRAMS)
+            taskHistogramAdd(&stats->executionTimeHistogram, taskExecutionTimeUs);
+#endif
+        } else
+#endif
+        {
+            SCHEDULER_TRACE(TRACE_TASK_START, selectedTask, currentTimeUs, 0);
+            runTaskFunc(selectedTask, currentTimeUs);
+            SCHEDULER_TRACE(TRACE_TASK_END, selectedTask, micros(), 0);
+        }
+#if defined(USE_SCHEDULER_TASK_CHAINS)
+        chainComplete(selectedTask, chainTriggered);
+#endif
+    }
+
+    return taskExecutionTimeUs;
+}
+
+/*
+ * Calls the task body, or resumes a resumable task for one slice
+ */
+void Scheduler::runTaskFunc(task_t *task, timeUs_t currentTimeUs)
+{
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+    if (task->resumeFunc) {
+        taskCoroutine_t *co = &taskState(task)->coroutine;
+        if (co->resumePoint == 0) {
+            co->runStartedAtUs = currentTimeUs;
+        }
+        co->awaitingSignal = false;
+        const taskResume_e result = task->resumeFunc(co, currentTimeUs);
+        const timeUs_t sliceEndedAtUs = micros();
+        if (result == TASK_YIELDED) {
+            co->resumeAtUs = sliceEndedAtUs;
+        }
+        co->signalled = false;
+#if defined(USE_TASK_STATISTICS)
+        taskStatistics_t *stats = taskStatistics(task);
+        stats->sliceCount++;
+        stats->runSlices++;
+        if (cmpTimeUs(sliceEndedAtUs, co->sliceEndUs) > 0) {
+            stats->sliceOverrunCount++;
+        }
+        if (result == TASK_DONE) {
+            stats->latestRunSlices = stats->runSlices;
+            stats->maxRunSlices = MAX(stats->maxRunSlices, stats->runSlices);
+            stats->runSlices = 0;
+        }
+#endif
+        return;
+    }
+#endif
+    task->taskFunc(currentTimeUs);
+}
+
+void Scheduler::taskSystemLoad(timeUs_t currentTimeUs)
+{
+    // Kept so the function still matches a task function, the load is not tied to the call time
+    (void)currentTimeUs;
+#if defined(USE_SCHEDULER_LOAD_ACCOUNTING)
+    // Time actually spent working instead of the number of waiting tasks
+    loadInfo_t loadInfo;
+    getLoadInfo(&loadInfo);
+    averageSystemLoadPercent = loadInfo.cpuLoadPercent;
+#else
+    // Calculate system load
+    if (totalWaitingTasksSamples > 0) {
+        averageSystemLoadPercent = 100 * totalWaitingTasks / totalWaitingTasksSamples;
+        totalWaitingTasksSamples = 0;
+        totalWaitingTasks = 0;
+    }
+#endif
+}
+
+void Scheduler::rescheduleTask(taskId_e taskId, timeDelta_t newPeriodUs)
+{
+    SCHEDULER_LOCK();
+    if (taskId == TASK_SELF || taskId < taskCount) {
+        task_t *task = taskId == TASK_SELF ? getCurrentTask() : getTask(taskId);
+#if defined(USE_SCHEDULER_PHASE_STAGGER)
+        const timeDelta_t oldPeriodUs = taskState(task)->desiredPeriodUs;
+#endif
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+        setTaskPeriod(task, MAX(SCHEDULER_DELAY_LIMIT, newPeriodUs));
+#else
+        taskState(task)->desiredPeriodUs = MAX(SCHEDULER_DELAY_LIMIT, newPeriodUs);  // Limit delay to 100us (10 kHz) to prevent scheduler clogging
+#endif
+#if defined(USE_SCHEDULER_PHASE_STAGGER)
+        if (taskState(task)->desiredPeriodUs != oldPeriodUs && queueContains(task)) {
+            staggerTask(task, micros());
+        }
+#endif
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+        heapUpdate(task);
+#elif defined(USE_SCHEDULER_SPLIT_TASKS)
+        queueUpdateDue(task);
+#endif
+    }
+}
+
+/*
+ * The period the task runs at now, rescheduleTask() and the overload governor change it
+ */
+timeDelta_t Scheduler::getTaskPeriodUs(taskId_e taskId)
+{
+    return taskState(taskId == TASK_SELF ? getCurrentTask() : getTask(taskId))->desiredPeriodUs;
+}
+
+#if defined(USE_SCHEDULER_ANCHORED_TIMING)
+/*
+ * Switching keeps the phase, an anchored task takes its grid from its last
+ * start. catchUpLimit only matters for TASK_TIMING_CATCH_UP.
+ */
+void Scheduler::setTaskTiming(taskId_e taskId, taskTiming_e timing, uint8_t catchUpLimit)
+{
+    SCHEDULER_LOCK();
+    if (taskId == TASK_SELF || taskId < taskCount) {
+        task_t *task = taskId == TASK_SELF ? getCurrentTask() : getTask(taskId);
+        taskState_t *state = taskState(task);
+        if (timing != TASK_TIMING_RELATIVE && state->timing == TASK_TIMING_RELATIVE) {
+            state->lastDesiredAt = state->lastExecutedAtUs;
+        }
+        state->timing = timing;
+        state->catchUpLimit = catchUpLimit;
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+        heapUpdate(task);
+#elif defined(USE_SCHEDULER_SPLIT_TASKS)
+        queueUpdateDue(task);
+#endif
+    }
+}
+#endif
+
+#if defined(USE_SCHEDULER_PHASE_STAGGER)
+static timeDelta_t greatestCommonDivisor(timeDelta_t a, timeDelta_t b)
+{
+    while (b > 0) {
+        const timeDelta_t remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+    return a;
+}
+
+inline timeDelta_t Scheduler::averageExecutionTimeUs(const task_t *task) const
+{
+#if defined(USE_TASK_STATISTICS)
+    const taskStatistics_t *stats = taskStatistics(task);
+    if (stats->movingSumExecutionTimeUs > 0) {
+        return stats->movingSumExecutionTimeUs / TASK_STATS_MOVING_SUM_COUNT + TASK_AVERAGE_EXECUTE_PADDING_US;
+    }
+#else
+    (void)task;
+#endif
+    return TASK_AVERAGE_EXECUTE_FALLBACK_US;
+}
+
+inline static bool isStaggered(const task_t *task, const taskState_t *state)
+{
+    return isTimeDriven(task) && !isInFlight(state);
+}
+
+/*
+ * Picks the first due time of a time-driven task within the next period. Two
+ * tasks with periods P1 and P2 meet at phase differences that repeat modulo
+ * gcd(P1, P2), so the closest their releases ever get is their phase distance
+ * modulo the gcd. Of SCHEDULER_PHASE_CANDIDATES evenly spaced phases the one
+ * overlapping the least with the execution windows of the other enabled tasks
+ * wins, ties go to the one furthest from its nearest neighbour.
+ */
+void Scheduler::staggerTask(task_t *task, timeUs_t currentTimeUs)
+{
+    taskState_t *state = taskState(task);
+    SCHEDULER_LOCK();
+    if (!isStaggered(task, state)) {
+        return;
+    }
+    const timeDelta_t periodUs = state->desiredPeriodUs;
+    const timeDelta_t executionTimeUs = averageExecutionTimeUs(task);
+    timeDelta_t bestOffsetUs = 0;
+    uint32_t bestOverlapUs = UINT32_MAX;
+    timeDelta_t bestDistanceUs = -1;
+    for (int candidate = 0; candidate < SCHEDULER_PHASE_CANDIDATES; candidate++) {
+        const timeDelta_t offsetUs = (int64_t)periodUs * candidate / SCHEDULER_PHASE_CANDIDATES;
+        uint32_t overlapUs = 0;
+        timeDelta_t distanceUs = INT32_MAX;
+        for (int ii = 0; ii < taskQueueSize; ii++) {
+            const task_t *other = taskQueueArray[ii];
+            const taskState_t *otherState = taskState(other);
+            if (other == task || !isStaggered(other, otherState)) {
+                continue;
+            }
+            const timeDelta_t gcdUs = greatestCommonDivisor(periodUs, otherState->desiredPeriodUs);
+            timeDelta_t phaseUs = cmpTimeUs(currentTimeUs + offsetUs, getPeriodCalculationBasis(other, otherState) + otherState->desiredPeriodUs) % gcdUs;
+            if (phaseUs < 0) {
+                phaseUs += gcdUs;
+            }
+            const timeDelta_t closestUs = MIN(phaseUs, gcdUs - phaseUs);
+            const timeDelta_t windowUs = MIN(executionTimeUs + averageExecutionTimeUs(other) + GUARD_INTERVAL_US, gcdUs / 2);
+            if (closestUs < windowUs) {
+                overlapUs += windowUs - closestUs;
+            }
+            distanceUs = MIN(distanceUs, closestUs);
+        }
+        if (overlapUs < bestOverlapUs || (overlapUs == bestOverlapUs && distanceUs > bestDistanceUs)) {
+            bestOffsetUs = offsetUs;
+            bestOverlapUs = overlapUs;
+            bestDistanceUs = distanceUs;
+        }
+    }
+    state->lastExecutedAtUs = currentTimeUs + bestOffsetUs - periodUs;
+    state->lastDesiredAt = state->lastExecutedAtUs;
+}
+#endif
+
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+/*
+ * Sets the nominal period of a task, a stretchable task runs at the nominal
+ * period times the current stretch factor
+ */
+void Scheduler::setTaskPeriod(task_t *task, timeDelta_t nominalPeriodUs)
+{
+    taskState_t *state = taskState(task);
+    if (overloadStretch > 256 && isStretchable(task)) {
+        state->nominalPeriodUs = nominalPeriodUs;
+        state->desiredPeriodUs = MIN((int64_t)INT32_MAX, MAX((int64_t)SCHEDULER_DELAY_LIMIT, ((int64_t)nominalPeriodUs * overloadStretch) >> 8));
+    } else {
+        state->nominalPeriodUs = 0;
+        state->desiredPeriodUs = nominalPeriodUs;
+    }
+}
+
+/*
+ * Once per window compares the background load with the ceiling. Above it the
+ * stretch factor grows by load / ceiling, below ceiling - hysteresis it shrinks by
+ * an eighth per window until the nominal periods are back.
+ */
+void Scheduler::updateOverloadGovernor(timeUs_t currentTimeUs)
+{
+    const timeDelta_t windowUs = cmpTimeUs(currentTimeUs, overloadWindowStartUs);
+    if (windowUs < SCHEDULER_OVERLOAD_WINDOW_US) {
+        return;
+    }
+    const uint8_t utilizationPercent = MIN((timeUs_t)100, overloadBusyUs * 100 / windowUs);
+    overloadWindowStartUs = currentTimeUs;
+    overloadBusyUs = 0;
+    overloadInfo.utilizationPercent = utilizationPercent;
+
+    uint16_t stretch = overloadStretch;
+    if (utilizationPercent > overloadCeilingPercent) {
+        stretch = MIN((uint32_t)SCHEDULER_OVERLOAD_MAX_STRETCH << 8, (uint32_t)stretch * utilizationPercent / overloadCeilingPercent);
+        overloadInfo.overloadWindows++;
+    } else if (utilizationPercent + SCHEDULER_OVERLOAD_HYSTERESIS_PERCENT < overloadCeilingPercent && stretch > 256) {
+        stretch = MAX(256, stretch - stretch / 8);
+    }
+    if (stretch == 256 && overloadStretch == 256) {
+        return;
+    }
+    overloadStretch = stretch;
+    // Every window, so tasks enabled since the last one are caught as well
+    for (task_t *task = queueFirst(); task != NULL; task = queueNext()) {
+        const taskState_t *state = taskState(task);
+        if ((state->nominalPeriodUs > 0 || isStretchable(task)) && !isInFlight(state)) {
+            setTaskPeriod(task, state->nominalPeriodUs > 0 ? state->nominalPeriodUs : state->desiredPeriodUs);
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+            heapUpdate(task);
+#elif defined(USE_SCHEDULER_SPLIT_TASKS)
+            queueUpdateDue(task);
+#endif
+        }
+    }
+}
+
+void Scheduler::setTaskBudget(taskId_e taskId, timeDelta_t budgetUs)
+{
+    if (taskId == TASK_SELF || taskId < taskCount) {
+        task_t *task = taskId == TASK_SELF ? getCurrentTask() : getTask(taskId);
+        taskState_t *state = taskState(task);
+        state->budgetUs = budgetUs;
+    }
+}
+
+void Scheduler::setOverloadCeiling(uint8_t ceilingPercent)
+{
+    overloadCeilingPercent = MAX(1, MIN(100, ceilingPercent));
+}
+
+void Scheduler::getOverloadInfo(overloadInfo_t *overloadInfo)
+{
+    *overloadInfo = this->overloadInfo;
+    overloadInfo->stretchPercent = ((uint32_t)overloadStretch * 100 + 128) >> 8;
+}
+#endif
+
+void Scheduler::setTaskEnabled(taskId_e taskId, bool enabled)
+{
+    if (taskId == TASK_SELF || taskId < taskCount) {
+        task_t *task = taskId == TASK_SELF ? getCurrentTask() : getTask(taskId);
+        if (enabled && (task->taskFunc
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+            || task->resumeFunc
+#endif
+            )) {
+#if defined(USE_SCHEDULER_ANCHORED_TIMING)
+            if (isTimeDriven(task) && !queueContains(task)) {
+                // Due right away, time spent disabled is neither drift nor missed releases
+                taskState_t *state = taskState(task);
+                state->lastExecutedAtUs = micros() - state->desiredPeriodUs;
+                state->lastDesiredAt = state->lastExecutedAtUs;
+            }
+#endif
+#if defined(USE_SCHEDULER_PHASE_STAGGER)
+            if (!queueContains(task)) {
+                staggerTask(task, micros());
+            }
+#endif
+            queueAdd(task);
+        } else {
+            queueRemove(task);
+        }
+    }
+}
+
+#if defined(USE_SCHEDULER_TASK_POOL)
+/*
+ * Runtime tasks live in a fixed pool next to the task table. Free slots are
+ * kept on a stack so allocation and release are O(1), and every release bumps
+ * the slot generation so a handle to a released task is refused.
+ */
+void Scheduler::poolReset(void)
+{
+    for (int slot = 0; slot < SCHEDULER_TASK_POOL_SIZE; slot++) {
+        // Handles to tasks dropped by the reset must go stale as well
+        if (taskPool[slot].taskFunc) {
+            poolGeneration[slot]++;
+        }
+        if (poolGeneration[slot] == 0) {
+            poolGeneration[slot] = 1;
+        }
+        taskPool[slot].taskFunc = NULL;
+        poolFreeSlots[slot] = SCHEDULER_TASK_POOL_SIZE - 1 - slot;
+    }
+    poolFreeCount = SCHEDULER_TASK_POOL_SIZE;
+    poolInfo.used = 0;
+}
+
+void Scheduler::poolRelease(uint8_t slot)
+{
+    taskPool[slot].taskFunc = NULL;
+    if (++poolGeneration[slot] == 0) {
+        poolGeneration[slot] = 1;
+    }
+    poolFreeSlots[poolFreeCount++] = slot;
+    poolInfo.used--;
+}
+
+taskHandle_t Scheduler::poolSchedule(void (*taskFunc)(timeUs_t currentTimeUs), timeDelta_t periodUs, timeDelta_t delayUs, int8_t priority, uint8_t taskFlags)
+{
+    SCHEDULER_LOCK();
+    if (!taskFunc || poolFreeCount == 0) {
+        poolInfo.allocationFailures++;
+        return TASK_HANDLE_NONE;
+    }
+    const uint8_t slot = poolFreeSlots[--poolFreeCount];
+    task_t *task = &taskPool[slot];
+    // task_t has a const member, so the slot is rebuilt in place
+    new (task) task_t(DEFINE_TASK("POOL", NULL, taskFunc, MAX(SCHEDULER_DELAY_LIMIT, periodUs), priority));
+    taskState_t *state = taskState(task);
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+    // The state and the statistics of the slot live apart from it, they start over as well
+    memset(state, 0, sizeof(*state));
+    state->desiredPeriodUs = task->desiredPeriodUs;
+#if defined(USE_TASK_STATISTICS)
+    memset(taskStatistics(task), 0, sizeof(taskStatistics_t));
+#endif
+#endif
+    task->taskFlags = taskFlags;
+    // Due when the delay is up, aging still counts in whole periods
+    state->lastExecutedAtUs = micros() + delayUs - state->desiredPeriodUs;
+    state->lastDesiredAt = state->lastExecutedAtUs;
+    queueAdd(task);
+    poolInfo.used++;
+    poolInfo.maxUsed = MAX(poolInfo.maxUsed, poolInfo.used);
+    return (taskHandle_t)(poolGeneration[slot] << 8 | slot);
+}
+
+/*
+ * Runs taskFunc once after delayUs, the slot is released after the run
+ */
+taskHandle_t Scheduler::scheduleOnce(void (*taskFunc)(timeUs_t currentTimeUs), timeDelta_t delayUs, int8_t priority)
+{
+    return poolSchedule(taskFunc, MAX(delayUs, 1), MAX(delayUs, 0), MAX(priority, (int8_t)TASK_PRIORITY_IDLE), TASK_FLAG_ONE_SHOT);
+}
+
+/*
+ * Runs taskFunc every periodUs, the first time a period from now, until cancelled
+ */
+taskHandle_t Scheduler::scheduleEvery(void (*taskFunc)(timeUs_t currentTimeUs), timeDelta_t periodUs, int8_t priority)
+{
+    return poolSchedule(taskFunc, periodUs, MAX(SCHEDULER_DELAY_LIMIT, periodUs), priority, 0);
+}
+
+/*
+ * Stops a pool task, returns false if the handle is stale or the one-shot task already ran
+ */
+bool Scheduler::cancel(taskHandle_t handle)
+{
+    SCHEDULER_LOCK();
+    const uint8_t slot = handle & 0xFF;
+    if (slot >= SCHEDULER_TASK_POOL_SIZE || poolGeneration[slot] != handle >> 8 || !taskPool[slot].taskFunc) {
+        return false;
+    }
+    queueRemove(&taskPool[slot]);
+#if defined(USE_SCHEDULER_EXECUTOR)
+    // Still running on the executor, the slot is released when the task is collected
+    if (taskState(&taskPool[slot])->inFlight) {
+        return true;
+    }
+#endif
+    poolRelease(slot);
+    return true;
+}
+
+void Scheduler::getTaskPoolInfo(taskPoolInfo_t *poolInfo)
+{
+    *poolInfo = this->poolInfo;
+}
+#endif
+
+// Polls the checkFunc of an event-driven task, traced as a span of its own
+inline bool Scheduler::callCheckFunc(task_t *task, timeUs_t currentTimeUs)
+{
+    taskState_t *state = taskState(task);
+#if defined(USE_SCHEDULER_TRACE)
+    // The pass time is stale after earlier checkFuncs, the trace needs the real start
+    const timeUs_t checkStartUs = micros();
+    SCHEDULER_TRACE(TRACE_CHECK_START, task, checkStartUs, 0);
+    const bool ready = task->checkFunc(currentTimeUs, cmpTimeUs(currentTimeUs, state->lastExecutedAtUs));
+    const timeUs_t checkEndUs = micros();
+    SCHEDULER_TRACE(TRACE_CHECK_END, task, checkEndUs, ready);
+#if defined(USE_SCHEDULER_LOAD_ACCOUNTING)
+    loadCheckFuncUs += checkEndUs - checkStartUs;
+#endif
+    return ready;
+#elif defined(USE_SCHEDULER_LOAD_ACCOUNTING)
+    const timeUs_t checkStartUs = micros();
+    const bool ready = task->checkFunc(currentTimeUs, cmpTimeUs(currentTimeUs, state->lastExecutedAtUs));
+    loadCheckFuncUs += micros() - checkStartUs;
+    return ready;
+#else
+    return task->checkFunc(currentTimeUs, cmpTimeUs(currentTimeUs, state->lastExecutedAtUs));
+#endif
+}
+
+/*
+ * Ages an event-driven task and polls its checkFunc, returns true if the task is waiting to run
+ */
+bool Scheduler::updateEventTask(task_t *task, timeUs_t currentTimeUs)
+{
+    taskState_t *state = taskState(task);
+#if defined(SCHEDULER_DEBUG)
+    const timeUs_t currentTimeBeforeCheckFuncCallUs = micros();
+#else
+    const timeUs_t currentTimeBeforeCheckFuncCallUs = currentTimeUs;
+#endif
+    // Increase priority for event driven tasks
+    if (state->dynamicPriority > 0) {
+        state->taskAgeCycles = 1 + ((currentTimeUs - state->lastSignaledAtUs) / state->desiredPeriodUs);
+        state->dynamicPriority = 1 + task->staticPriority * state->taskAgeCycles;
+        return true;
+    } else if (__atomic_load_n(&state->signalPending, __ATOMIC_ACQUIRE)) {
+        // Signalled through signalTask(), no need to poll the checkFunc. The stamp is taken
+        // before the flag is cleared, a signal arriving after that stamps the next run.
+        state->lastSignaledAtUs = state->signalPendingAtUs;
+        __atomic_store_n(&state->signalPending, 0, __ATOMIC_RELEASE);
+        state->taskAgeCycles = 1;
+        state->dynamicPriority = 1 + task->staticPriority;
+        return true;
+    } else if (task->checkFunc && callCheckFunc(task, currentTimeBeforeCheckFuncCallUs)) {
+
+#if defined(USE_TASK_STATISTICS)
+        if (calculateTaskStatistics) {
+            const uint32_t checkFuncExecutionTimeUs = micros() - currentTimeBeforeCheckFuncCallUs;
+            checkFuncMovingSumExecutionTimeUs += checkFuncExecutionTimeUs - checkFuncMovingSumExecutionTimeUs / TASK_STATS_MOVING_SUM_COUNT;
+            checkFuncMovingSumDeltaTimeUs += state->taskLatestDeltaTimeUs - checkFuncMovingSumDeltaTimeUs / TASK_STATS_MOVING_SUM_COUNT;
+            checkFuncTotalExecutionTimeUs += checkFuncExecutionTimeUs;   // time consumed by scheduler + task
+            checkFuncMaxExecutionTimeUs = MAX(checkFuncMaxExecutionTimeUs, checkFuncExecutionTimeUs);
+        }
+#endif
+        state->lastSignaledAtUs = currentTimeBeforeCheckFuncCallUs;
+        state->taskAgeCycles = 1;
+        state->dynamicPriority = 1 + task->staticPriority;
+        return true;
+    } else {
+        state->taskAgeCycles = 0;
+        return false;
+    }
 }
 
-bool Scheduler::queueAdd(task_t *task)
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+/*
+ * Ages a resumable task, returns true if it is waiting to start a run or to
+ * continue one. A task awaiting a signal is woken early by signalTask().
+ */
+bool Scheduler::updateResumableTask(task_t *task, timeUs_t currentTimeUs)
 {
-    if ((taskQueueSize >= TASK_COUNT) || queueContains(task)) {
-        return false;
+    taskState_t *state = taskState(task);
+    taskCoroutine_t *co = &state->coroutine;
+    if (co->awaitingSignal && __atomic_load_n(&state->signalPending, __ATOMIC_ACQUIRE)) {
+        co->awaitingSignal = false;
+        co->signalled = true;
+        co->resumeAtUs = state->signalPendingAtUs;
+        state->lastSignaledAtUs = co->resumeAtUs;
+        __atomic_store_n(&state->signalPending, 0, __ATOMIC_RELEASE);
     }
-    for (int ii = 0; ii <= taskQueueSize; ++ii) {
-        if (taskQueueArray[ii] == NULL || taskQueueArray[ii]->staticPriority < task->staticPriority) {
-            memmove(&taskQueueArray[ii+1], &taskQueueArray[ii], sizeof(task) * (taskQueueSize - ii));
-            taskQueueArray[ii] = task;
-            ++taskQueueSize;
-            return true;
-        }
+    const timeDelta_t overdueUs = cmpTimeUs(currentTimeUs, resumableDueAtUs(state));
+    if (overdueUs < 0) {
+        state->taskAgeCycles = 0;
+        return false;
     }
-    return false;
+    state->taskAgeCycles = 1 + overdueUs / state->desiredPeriodUs;
+    state->dynamicPriority = 1 + task->staticPriority * state->taskAgeCycles;
+    return true;
 }
+#endif
 
-bool Scheduler::queueRemove(task_t *task)
+/*
+ * Marks an event-driven task ready to run. Lock-free and safe to call from an interrupt,
+ * signals arriving before the task runs are merged into a single run. Only the signal
+ * that raises the flag stamps it, so the stamp does not change while the flag is set.
+ */
+void Scheduler::signalTask(taskId_e taskId)
 {
-    for (int ii = 0; ii < taskQueueSize; ++ii) {
-        if (taskQueueArray[ii] == task) {
-            memmove(&taskQueueArray[ii], &taskQueueArray[ii+1], sizeof(task) * (taskQueueSize - ii));
-            --taskQueueSize;
-            return true;
+    if (taskId < taskCount) {
+        task_t *task = getTask(taskId);
+        taskState_t *state = taskState(task);
+        if (!__atomic_load_n(&state->signalPending, __ATOMIC_ACQUIRE)) {
+            state->signalPendingAtUs = micros();
+            __atomic_store_n(&state->signalPending, 1, __ATOMIC_RELEASE);
         }
+        __atomic_store_n(&signalsPending, 1, __ATOMIC_RELEASE);
+        SCHEDULER_TRACE(TRACE_SIGNAL, task, micros(), 0);
     }
-    return false;
 }
 
+bool Scheduler::signalPending(void)
+{
+    return __atomic_load_n(&signalsPending, __ATOMIC_ACQUIRE);
+}
+
+#if defined(USE_SCHEDULER_TASK_CHAINS)
 /*
- * Returns first item queue or NULL if queue empty
+ * Completion triggers. Every successor link is an edge in a small table that
+ * also keeps its statistics. When a task returns its successors are signalled
+ * like signalTask() does and get its output payload, so successors must be
+ * event-driven (DEFINE_SIGNAL_TASK). run_scheduler() runs a signalled
+ * successor right away while the realtime guard window has room.
  */
-task_t* Scheduler::queueFirst(void)
+bool Scheduler::addTaskSuccessor(taskId_e taskId, taskId_e successorId)
 {
-    taskQueuePos = 0;
-    return taskQueueArray[0]; // guaranteed to be NULL if queue is empty
+    if (taskId >= taskCount || successorId >= taskCount || taskId == successorId || taskEdgeCount >= SCHEDULER_MAX_TASK_EDGES) {
+        return false;
+    }
+    task_t *task = getTask(taskId);
+    taskState_t *state = taskState(task);
+    task_t *successor = getTask(successorId);
+    if (state->successorCount >= SCHEDULER_MAX_SUCCESSORS || !isEventDriven(successor)
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+        || successor->resumeFunc
+#endif
+        ) {
+        return false;
+    }
+    taskEdge_t *edge = &taskEdges[taskEdgeCount];
+    memset(edge, 0, sizeof(*edge));
+    edge->taskId = taskId;
+    edge->successorId = successorId;
+    state->successorEdges[state->successorCount++] = taskEdgeCount++;
+    return true;
 }
 
 /*
- * Returns next item in queue or NULL if at end of queue
+ * Payload handed to the successors of the running task when it returns. A
+ * successor that has not run yet sees the latest one, like merged signals.
  */
-task_t* Scheduler::queueNext(void)
+void Scheduler::setTaskOutput(uint32_t payload)
 {
-    return taskQueueArray[++taskQueuePos]; // guaranteed to be NULL at end of queue
+    taskState(getCurrentTask())->chainOutput = payload;
 }
 
-task_t* Scheduler::getTask(unsigned taskId)
+uint32_t Scheduler::getTaskInput(void)
 {
-    return &tasks[taskId];
+    return taskState(getCurrentTask())->chainInput;
 }
 
-timeUs_t Scheduler::schedulerExecuteTask(task_t *selectedTask, timeUs_t currentTimeUs)
+int Scheduler::getTaskEdgeCount(void)
 {
-    timeUs_t taskExecutionTimeUs = 0;
+    return taskEdgeCount;
+}
 
-    if (selectedTask) {
-        currentTask = selectedTask;
-        selectedTask->taskLatestDeltaTimeUs = cmpTimeUs(currentTimeUs, selectedTask->lastExecutedAtUs);
+void Scheduler::getTaskEdgeInfo(int edge, taskEdgeInfo_t *edgeInfo)
+{
+    const taskEdge_t *taskEdge = &taskEdges[edge];
+    edgeInfo->taskId = taskEdge->taskId;
+    edgeInfo->successorId = taskEdge->successorId;
+    edgeInfo->triggerCount = taskEdge->triggerCount;
+    edgeInfo->samePassCount = taskEdge->samePassCount;
+    edgeInfo->latestLatencyUs = taskEdge->latestLatencyUs;
+    edgeInfo->maxLatencyUs = taskEdge->maxLatencyUs;
 #if defined(USE_TASK_STATISTICS)
-        float period = currentTimeUs - selectedTask->lastExecutedAtUs;
+    edgeInfo->averageLatencyUs = taskEdge->movingSumLatencyUs / TASK_STATS_MOVING_SUM_COUNT;
+#else
+    edgeInfo->averageLatencyUs = 0;
 #endif
-        selectedTask->lastExecutedAtUs = currentTimeUs;
-        selectedTask->lastDesiredAt += (cmpTimeUs(currentTimeUs, selectedTask->lastDesiredAt) / selectedTask->desiredPeriodUs) * selectedTask->desiredPeriodUs;
-        selectedTask->dynamicPriority = 0;
+}
 
-        // Execute task
+/*
+ * A run signalled by an upstream task continues its chain, any other run
+ * starts a new one. Returns true for a continued chain.
+ */
+bool Scheduler::chainStart(task_t *task, timeUs_t currentTimeUs)
+{
+    taskState_t *state = taskState(task);
+    const uint8_t triggerEdge = state->triggerEdge;
+    state->triggerEdge = 0;
+    if (triggerEdge) {
 #if defined(USE_TASK_STATISTICS)
-        if (calculateTaskStatistics) {
-            const timeUs_t currentTimeBeforeTaskCallUs = micros();
-            selectedTask->taskFunc(currentTimeBeforeTaskCallUs);
-            taskExecutionTimeUs = micros() - currentTimeBeforeTaskCallUs;
-            selectedTask->movingSumExecutionTimeUs += taskExecutionTimeUs - selectedTask->movingSumExecutionTimeUs / TASK_STATS_MOVING_SUM_COUNT;
-            selectedTask->movingSumDeltaTimeUs += selectedTask->taskLatestDeltaTimeUs - selectedTask->movingSumDeltaTimeUs / TASK_STATS_MOVING_SUM_COUNT;
-            selectedTask->totalExecutionTimeUs += taskExecutionTimeUs;   // time consumed by scheduler + task
-            selectedTask->maxExecutionTimeUs = MAX(selectedTask->maxExecutionTimeUs, taskExecutionTimeUs);
-            selectedTask->movingAverageCycleTimeUs += 0.05f * (period - selectedTask->movingAverageCycleTimeUs);
-        } else
+        taskEdge_t *edge = &taskEdges[triggerEdge - 1];
+        edge->latestLatencyUs = cmpTimeUs(currentTimeUs, state->lastSignaledAtUs);
+        edge->maxLatencyUs = MAX(edge->maxLatencyUs, edge->latestLatencyUs);
+        edge->movingSumLatencyUs += edge->latestLatencyUs - edge->movingSumLatencyUs / TASK_STATS_MOVING_SUM_COUNT;
 #endif
-        {
-            selectedTask->taskFunc(currentTimeUs);
-        }
+        return true;
+    }
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+    // Later slices of a resumable run belong to the chain its first slice started
+    if (task->resumeFunc && state->coroutine.resumePoint) {
+        return false;
     }
+#endif
+    state->chainStartedAtUs = currentTimeUs;
+    return false;
+}
 
-    return taskExecutionTimeUs;
+/*
+ * Signals the successors of a task that returned, and measures the whole
+ * chain when the last task of one returns
+ */
+void Scheduler::chainComplete(task_t *task, bool triggered)
+{
+    taskState_t *state = taskState(task);
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+    // Only a finished run counts, not the end of a slice
+    if (task->resumeFunc && state->coroutine.resumePoint) {
+        return;
+    }
+#endif
+    if (state->successorCount == 0 && !triggered) {
+        return;
+    }
+    const timeUs_t completedAtUs = micros();
+    for (int ii = 0; ii < state->successorCount; ii++) {
+        taskEdge_t *edge = &taskEdges[state->successorEdges[ii]];
+        task_t *successor = getTask(edge->successorId);
+        taskState_t *successorState = taskState(successor);
+        successorState->chainInput = state->chainOutput;
+        successorState->chainStartedAtUs = state->chainStartedAtUs;
+        successorState->triggerEdge = state->successorEdges[ii] + 1;
+        edge->triggerCount++;
+        if (!__atomic_load_n(&successorState->signalPending, __ATOMIC_ACQUIRE)) {
+            successorState->signalPendingAtUs = completedAtUs;
+            __atomic_store_n(&successorState->signalPending, 1, __ATOMIC_RELEASE);
+        }
+        __atomic_store_n(&signalsPending, 1, __ATOMIC_RELEASE);
+        SCHEDULER_TRACE(TRACE_SIGNAL, successor, completedAtUs, 0);
+    }
+#if defined(USE_TASK_STATISTICS)
+    if (state->successorCount == 0) {
+        taskStatistics_t *stats = taskStatistics(task);
+        stats->latestChainLatencyUs = cmpTimeUs(completedAtUs, state->chainStartedAtUs);
+        stats->maxChainLatencyUs = MAX(stats->maxChainLatencyUs, stats->latestChainLatencyUs);
+    }
+#endif
 }
 
-inline static timeUs_t getPeriodCalculationBasis(const task_t* task)
+/*
+ * A successor that the task just signalled and that is enabled, NULL if none
+ */
+task_t* Scheduler::chainNext(task_t *task)
 {
-    if (task->staticPriority == TASK_PRIORITY_REALTIME) {
-        return *(timeUs_t*)((uint8_t*)task + periodCalculationBasisOffset);
-    } else {
-        return task->lastExecutedAtUs;
+    taskState_t *state = taskState(task);
+    for (int ii = 0; ii < state->successorCount; ii++) {
+        task_t *successor = getTask(taskEdges[state->successorEdges[ii]].successorId);
+        taskState_t *successorState = taskState(successor);
+        if (successorState->signalPending && successorState->triggerEdge == state->successorEdges[ii] + 1 && queueContains(successor)) {
+            return successor;
+        }
     }
+    return NULL;
 }
+#endif
 
-void Scheduler::taskSystemLoad(timeUs_t currentTimeUs)
+/*
+ * Time until the scheduler has work again: the earliest realtime or time-driven
+ * due time, capped at the period of tasks whose checkFunc has to be polled.
+ * Signal-driven tasks don't limit it, signalTask() wakes the sleep hook instead.
+ */
+timeDelta_t Scheduler::idleTimeUs(timeUs_t currentTimeUs)
 {
-    // Calculate system load
-    if (totalWaitingTasksSamples > 0) {
-        averageSystemLoadPercent = 100 * totalWaitingTasks / totalWaitingTasksSamples;
-        totalWaitingTasksSamples = 0;
-        totalWaitingTasks = 0;
+    timeDelta_t idleUs = INT32_MAX;
+#if defined(USE_SCHEDULER_EXECUTOR)
+    // Completions are polled, so don't sleep long while tasks are out
+    if (inFlightCount > 0) {
+        idleUs = SCHEDULER_EXECUTOR_POLL_US;
+    }
+    // Once the executor is full the background tasks waiting for it are no work for this thread
+    const bool skipBackground = executor && executorFull;
+#else
+    const bool skipBackground = false;
+#endif
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+    if (logLinePos < logLineLength || logHead != logTail) {
+        return 0;
     }
+#endif
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+    if (taskHeapSize > 0 && !skipBackground) {
+        idleUs = MIN(idleUs, cmpTimeUs(taskState(taskHeapArray[0])->nextDueAtUs, currentTimeUs));
+    }
+    for (int ii = 0; ii < taskEventSize; ++ii) {
+        const task_t *task = taskEventArray[ii];
+        const taskState_t *state = taskState(task);
+        if (isInFlight(state) || skipBackground) {
+            continue;
+        }
+        if (state->dynamicPriority > 0) {
+            return 0;
+        }
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+        if (task->resumeFunc) {
+            idleUs = MIN(idleUs, cmpTimeUs(resumableDueAtUs(state), currentTimeUs));
+        }
+#endif
+        if (task->checkFunc) {
+            idleUs = MIN(idleUs, state->desiredPeriodUs);
+        }
+    }
+    for (int ii = 0; ii < realtimeQueueSize; ++ii) {
+        const task_t *task = realtimeQueueArray[ii];
+        const taskState_t *state = taskState(task);
+        idleUs = MIN(idleUs, cmpTimeUs(getPeriodCalculationBasis(task, state) + state->desiredPeriodUs, currentTimeUs));
+    }
+#else
+    for (int ii = 0; ii < taskQueueSize; ++ii) {
+        const task_t *task = taskQueueArray[ii];
+        const taskState_t *state = taskState(task);
+        if (isInFlight(state) || (skipBackground && task->staticPriority != TASK_PRIORITY_REALTIME)) {
+            continue;
+        }
+        if (state->dynamicPriority > 0) {
+            return 0;
+        }
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+        if (task->resumeFunc) {
+            idleUs = MIN(idleUs, cmpTimeUs(resumableDueAtUs(state), currentTimeUs));
+        } else
+#endif
+        if (isEventDriven(task)) {
+            if (task->checkFunc) {
+                idleUs = MIN(idleUs, state->desiredPeriodUs);
+            }
+        } else {
+            idleUs = MIN(idleUs, cmpTimeUs(getPeriodCalculationBasis(task, state) + state->desiredPeriodUs, currentTimeUs));
+        }
+    }
+#endif
+    return MAX(idleUs, 0);
 }
 
-void Scheduler::rescheduleTask(taskId_e taskId, timeDelta_t newPeriodUs)
+void Scheduler::setSleepFunc(schedulerSleepFunc_t sleepFunc)
 {
-    if (taskId == TASK_SELF) {
-        task_t *task = currentTask;
-        task->desiredPeriodUs = MAX(SCHEDULER_DELAY_LIMIT, newPeriodUs);  // Limit delay to 100us (10 kHz) to prevent scheduler clogging
-    } else if (taskId < TASK_COUNT) {
-        task_t *task = getTask(taskId);
-        task->desiredPeriodUs = MAX(SCHEDULER_DELAY_LIMIT, newPeriodUs);  // Limit delay to 100us (10 kHz) to prevent scheduler clogging
+    this->sleepFunc = sleepFunc;
+}
+
+void Scheduler::getIdleInfo(idleInfo_t *idleInfo)
+{
+    *idleInfo = this->idleInfo;
+}
+
+#if defined(USE_SCHEDULER_EXECUTOR)
+/*
+ * Hands background tasks to an executor. Realtime tasks stay on the thread
+ * calling run_scheduler(), everything else that is ready is submitted in
+ * dynamic priority order while the executor accepts it. Set it before the
+ * scheduler runs, or with no task in flight. At most SCHEDULER_EXECUTOR_THREADS
+ * threads, the scheduler's own included, may run its tasks.
+ */
+void Scheduler::setExecutor(SchedulerExecutor *executor)
+{
+    this->executor = executor;
+    // The threads of an executor that is gone give their slots back, the caller is
+    // normally the thread running run_scheduler() and keeps slot 0
+    memset(currentTasks, 0, sizeof(currentTasks));
+    currentTasks[0].thread = &threadKey;
+}
+
+/*
+ * Submits ready tasks, highest dynamic priority first, until none is left or the
+ * executor is full. Returns the first task submitted.
+ */
+task_t* Scheduler::executorDispatch(timeUs_t currentTimeUs)
+{
+    task_t *firstTask = NULL;
+    for (;;) {
+        task_t *selectedTask = NULL;
+        uint32_t selectedTaskRank = 0;
+        for (int ii = 0; ii < taskQueueSize; ++ii) {
+            task_t *task = taskQueueArray[ii];
+            taskState_t *state = taskState(task);
+            if (state->inFlight || task->staticPriority == TASK_PRIORITY_REALTIME) {
+                continue;
+            }
+            const uint32_t rank = getTaskRank(task, state, currentTimeUs);
+            if (rank > selectedTaskRank) {
+                selectedTaskRank = rank;
+                selectedTask = task;
+            }
+        }
+        if (!selectedTask) {
+            break;
+        }
+        taskState_t *selectedState = taskState(selectedTask);
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+        // Off the realtime thread a slice only has to leave room for the others
+        if (selectedTask->resumeFunc) {
+            selectedState->coroutine.sliceEndUs = currentTimeUs + SCHEDULER_MAX_SLICE_US;
+        }
+#endif
+        selectedState->inFlight = true;
+        if (!executor->submit(selectedTask, currentTimeUs)) {
+            selectedState->inFlight = false;
+            executorFull = true;
+            break;
+        }
+        inFlightCount++;
+        if (!firstTask) {
+            firstTask = selectedTask;
+        }
     }
+    return firstTask;
 }
 
-void Scheduler::setTaskEnabled(taskId_e taskId, bool enabled)
+/*
+ * Takes back the tasks the executor finished and does the bookkeeping the
+ * inline path does right after a task ran
+ */
+void Scheduler::executorCollect(void)
 {
-    if (taskId == TASK_SELF || taskId < TASK_COUNT) {
-        task_t *task = taskId == TASK_SELF ? currentTask : getTask(taskId);
-        if (enabled && task->taskFunc) {
-            queueAdd(task);
-        } else {
+    timeUs_t executionTimeUs;
+    for (task_t *task = executor->completed(&executionTimeUs); task != NULL; task = executor->completed(&executionTimeUs)) {
+        taskState(task)->inFlight = false;
+        inFlightCount--;
+        executorFull = false;
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+        if (isStretchable(task)) {
+            overloadBusyUs += executionTimeUs;
+        }
+#endif
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+        heapUpdate(task);
+#elif defined(USE_SCHEDULER_SPLIT_TASKS)
+        queueUpdateDue(task);
+#endif
+#if defined(USE_SCHEDULER_TASK_POOL)
+        // A one-shot task is done, a cancelled one was left in its slot until now
+        if (task >= taskPool && task < taskPool + SCHEDULER_TASK_POOL_SIZE
+            && ((task->taskFlags & TASK_FLAG_ONE_SHOT) || !queueContains(task))) {
             queueRemove(task);
+            poolRelease(task - taskPool);
         }
+#endif
     }
 }
+#endif
 
 void Scheduler::run_scheduler(void)
 {
@@ -181,96 +1550,335 @@ void Scheduler::run_scheduler(void)
     timeUs_t currentTimeUs = schedulerStartTimeUs;
     timeUs_t taskExecutionTimeUs = 0;
     task_t *selectedTask = NULL;
-    uint16_t selectedTaskDynamicPriority = 0;
+    uint32_t selectedTaskRank = 0;
     uint16_t waitingTasks = 0;
     bool realtimeTaskRan = false;
-    timeDelta_t mainTaskDelayUs = 0;
+#if defined(USE_SCHEDULER_EXECUTOR)
+    if (executor) {
+        // Held only while the queues are read or changed, never while a task runs on this thread
+        SCHEDULER_LOCK();
+        executorCollect();
+    }
+#endif
+
+    // Cleared before the event tasks are looked at, so a signal arriving during the pass keeps it set
+    __atomic_store_n(&signalsPending, 0, __ATOMIC_RELEASE);
 
-    task_t *mainTask = getTask(TASK_MAIN);
-    const timeUs_t mainExecuteTimeUs = getPeriodCalculationBasis(mainTask) + mainTask->desiredPeriodUs;
-    mainTaskDelayUs = cmpTimeUs(mainExecuteTimeUs, currentTimeUs);
-    if (cmpTimeUs(currentTimeUs, mainExecuteTimeUs) >= 0) {
-        taskExecutionTimeUs = schedulerExecuteTask(mainTask, currentTimeUs);
+    // Realtime lane, every due realtime task runs once per pass in earliest deadline first order
+    {
+        SCHEDULER_LOCK();
+        for (int ii = 0; ii < realtimeQueueSize; ++ii) {
+            taskState(realtimeQueueArray[ii])->realtimeRanThisPass = false;
+        }
+    }
+    for (;;) {
+        task_t *realtimeTask = NULL;
+        timeUs_t realtimeTaskDeadlineUs = 0;
+        {
+            SCHEDULER_LOCK();
+            for (int ii = 0; ii < realtimeQueueSize; ++ii) {
+                task_t *task = realtimeQueueArray[ii];
+                const taskState_t *state = taskState(task);
+                const timeUs_t deadlineUs = getPeriodCalculationBasis(task, state) + state->desiredPeriodUs;
+                if (cmpTimeUs(currentTimeUs, deadlineUs) >= 0 && !state->realtimeRanThisPass
+                    && (!realtimeTask || cmpTimeUs(deadlineUs, realtimeTaskDeadlineUs) < 0)) {
+                    realtimeTask = task;
+                    realtimeTaskDeadlineUs = deadlineUs;
+                }
+            }
+        }
+        if (!realtimeTask) {
+            break;
+        }
+#if defined(USE_TASK_STATISTICS)
+        taskStatistics_t *stats = taskStatistics(realtimeTask);
+        stats->latestRealtimeLatenessUs = cmpTimeUs(currentTimeUs, realtimeTaskDeadlineUs);
+        stats->maxRealtimeLatenessUs = MAX(stats->maxRealtimeLatenessUs, stats->latestRealtimeLatenessUs);
+        if (stats->latestRealtimeLatenessUs > REALTIME_LATE_LIMIT_US) {
+            stats->realtimeLateCount++;
+        }
+#endif
+#if defined(USE_SCHEDULER_TRACE)
+        const timeDelta_t realtimeLatenessUs = cmpTimeUs(currentTimeUs, realtimeTaskDeadlineUs);
+        if (realtimeLatenessUs > REALTIME_LATE_LIMIT_US) {
+            traceRecord(TRACE_DEADLINE_MISS, realtimeTask, currentTimeUs, MIN(realtimeLatenessUs, (timeDelta_t)UINT16_MAX));
+            uint16_t countdown = 0;
+            if (traceStopOnMiss && traceEnabled) {
+                __atomic_compare_exchange_n(&traceStopCountdown, &countdown, (uint16_t)(SCHEDULER_TRACE_SIZE / 4), false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+            }
+        }
+#endif
+        taskState(realtimeTask)->realtimeRanThisPass = true;
+        taskExecutionTimeUs += schedulerExecuteTask(realtimeTask, currentTimeUs);
         currentTimeUs = micros();
         realtimeTaskRan = true;
     }
 
+    // From here on the pass only selects and submits, it runs no task while an executor is set
+    SCHEDULER_LOCK();
+
+    // The guard window is set by the soonest realtime deadline. When the task owning it has
+    // just run its next deadline is a whole period away, so a background task may run regardless
+    timeDelta_t realtimeDelayUs = INT32_MAX;
+    bool soonestRealtimeRan = false;
+    for (int ii = 0; ii < realtimeQueueSize; ++ii) {
+        const task_t *task = realtimeQueueArray[ii];
+        const taskState_t *state = taskState(task);
+        const timeDelta_t delayUs = cmpTimeUs(getPeriodCalculationBasis(task, state) + state->desiredPeriodUs, currentTimeUs);
+        if (delayUs < realtimeDelayUs) {
+            realtimeDelayUs = delayUs;
+            soonestRealtimeRan = state->realtimeRanThisPass;
+        }
+    }
+    const bool realtimeLaneClear = realtimeTaskRan && soonestRealtimeRan;
+
     // if something goes wrong look this variable
-    // SerialDebug.println(mainTaskDelayUs);
+    // SerialDebug.println(realtimeDelayUs);
 
-    if (realtimeTaskRan || (mainTaskDelayUs > GUARD_INTERVAL_US)) {
+#if defined(USE_SCHEDULER_EXECUTOR)
+    // Executor threads can't hold up the realtime lane, so they are fed on every pass
+    if (executor || realtimeLaneClear || (realtimeDelayUs > GUARD_INTERVAL_US)) {
+#else
+    if (realtimeLaneClear || (realtimeDelayUs > GUARD_INTERVAL_US)) {
+#endif
         // The task to be invoked
 
         // Update task dynamic priorities
-        for (task_t *task = queueFirst(); task != NULL; task = queueNext()) {
-            if (task->staticPriority != TASK_PRIORITY_REALTIME) {
-                // Task has checkFunc - event driven
-                if (task->checkFunc) {
-#if defined(SCHEDULER_DEBUG)
-                    const timeUs_t currentTimeBeforeCheckFuncCallUs = micros();
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+        for (int ii = 0; ii < taskEventSize; ++ii) {
+            task_t *task = taskEventArray[ii];
+            const taskState_t *state = taskState(task);
+            if (isInFlight(state)) {
+                continue;
+            }
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+            if (task->resumeFunc ? updateResumableTask(task, currentTimeUs) : updateEventTask(task, currentTimeUs)) {
+#else
+            if (updateEventTask(task, currentTimeUs)) {
+#endif
+                waitingTasks++;
+            }
+            const uint32_t rank = getTaskRank(task, state, currentTimeUs);
+            if (rank > selectedTaskRank) {
+                selectedTaskRank = rank;
+                selectedTask = task;
+            }
+        }
+        heapSelectDue(0, currentTimeUs, &selectedTask, &selectedTaskRank, &waitingTasks);
 #else
-                    const timeUs_t currentTimeBeforeCheckFuncCallUs = currentTimeUs;
+        // Realtime tasks sort last in the queue and had their turn in the realtime lane
+        const int backgroundQueueSize = taskQueueSize - realtimeQueueSize;
+        for (int ii = 0; ii < backgroundQueueSize; ++ii) {
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+            // A time-driven task that is not due would age 0 periods, pass it over without loading it
+            if ((timeUs_t)(currentTimeUs - taskQueueBasisUs[ii]) < (timeUs_t)taskQueuePeriodUs[ii]) {
+                continue;
+            }
 #endif
-                    // Increase priority for event driven tasks
-                    if (task->dynamicPriority > 0) {
-                        task->taskAgeCycles = 1 + ((currentTimeUs - task->lastSignaledAtUs) / task->desiredPeriodUs);
-                        task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
+            task_t *task = taskQueueArray[ii];
+            taskState_t *state = taskState(task);
+            if (task->staticPriority != TASK_PRIORITY_REALTIME && !isInFlight(state)) {
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+                if (task->resumeFunc) {
+                    if (updateResumableTask(task, currentTimeUs)) {
                         waitingTasks++;
-                    } else if (task->checkFunc(currentTimeBeforeCheckFuncCallUs, cmpTimeUs(currentTimeBeforeCheckFuncCallUs, task->lastExecutedAtUs))) {
-
-#if defined(USE_TASK_STATISTICS)
-                        if (calculateTaskStatistics) {
-                            const uint32_t checkFuncExecutionTimeUs = micros() - currentTimeBeforeCheckFuncCallUs;
-                            checkFuncMovingSumExecutionTimeUs += checkFuncExecutionTimeUs - checkFuncMovingSumExecutionTimeUs / TASK_STATS_MOVING_SUM_COUNT;
-                            checkFuncMovingSumDeltaTimeUs += task->taskLatestDeltaTimeUs - checkFuncMovingSumDeltaTimeUs / TASK_STATS_MOVING_SUM_COUNT;
-                            checkFuncTotalExecutionTimeUs += checkFuncExecutionTimeUs;   // time consumed by scheduler + task
-                            checkFuncMaxExecutionTimeUs = MAX(checkFuncMaxExecutionTimeUs, checkFuncExecutionTimeUs);
-                        }
-#endif
-                        task->lastSignaledAtUs = currentTimeBeforeCheckFuncCallUs;
-                        task->taskAgeCycles = 1;
-                        task->dynamicPriority = 1 + task->staticPriority;
+                    }
+                } else
+#endif
+                // Task has checkFunc or is signalled - event driven
+                if (isEventDriven(task)) {
+                    if (updateEventTask(task, currentTimeUs)) {
                         waitingTasks++;
-                    } else {
-                        task->taskAgeCycles = 0;
                     }
                 } else {
                     // Task is time-driven, dynamicPriority is last execution age (measured in desiredPeriods)
                     // Task age is calculated from last execution
-                    task->taskAgeCycles = ((currentTimeUs - getPeriodCalculationBasis(task)) / task->desiredPeriodUs);
-                    if (task->taskAgeCycles > 0) {
-                        task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
+                    state->taskAgeCycles = ((currentTimeUs - getPeriodCalculationBasis(task, state)) / state->desiredPeriodUs);
+                    if (state->taskAgeCycles > 0) {
+                        state->dynamicPriority = 1 + task->staticPriority * state->taskAgeCycles;
                         waitingTasks++;
                     }
                 }
 
-                if (task->dynamicPriority > selectedTaskDynamicPriority) {
-                    selectedTaskDynamicPriority = task->dynamicPriority;
+                const uint32_t rank = getTaskRank(task, state, currentTimeUs);
+                if (rank > selectedTaskRank) {
+                    selectedTaskRank = rank;
                     selectedTask = task;
                 }
             }
         }
+#endif
 
         totalWaitingTasksSamples++;
         totalWaitingTasks += waitingTasks;
 
+#if defined(USE_SCHEDULER_EXECUTOR)
+        if (executor) {
+            selectedTask = executorDispatch(currentTimeUs);
+        } else
+#endif
         if (selectedTask) {
             timeDelta_t taskRequiredTimeUs = TASK_AVERAGE_EXECUTE_FALLBACK_US;  // default average time if task statistics are not available
 #if defined(USE_TASK_STATISTICS)
             if (calculateTaskStatistics) {
-                taskRequiredTimeUs = selectedTask->movingSumExecutionTimeUs / TASK_STATS_MOVING_SUM_COUNT + TASK_AVERAGE_EXECUTE_PADDING_US;
+                taskRequiredTimeUs = taskStatistics(selectedTask)->movingSumExecutionTimeUs / TASK_STATS_MOVING_SUM_COUNT + TASK_AVERAGE_EXECUTE_PADDING_US;
+            }
+#endif
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+            // A resumable task yields at the end of its slice, it only needs room for a short one
+            if (selectedTask->resumeFunc) {
+                taskRequiredTimeUs = SCHEDULER_MIN_SLICE_US;
+                taskState(selectedTask)->coroutine.sliceEndUs = currentTimeUs + MIN(realtimeDelayUs - GUARD_INTERVAL_US, (timeDelta_t)SCHEDULER_MAX_SLICE_US);
             }
 #endif
             // Add in the time spent so far in check functions and the scheduler logic
             taskRequiredTimeUs += cmpTimeUs(micros(), currentTimeUs);
-            if (realtimeTaskRan || (taskRequiredTimeUs < mainTaskDelayUs)) {
-                taskExecutionTimeUs += schedulerExecuteTask(selectedTask, currentTimeUs);
+            if (realtimeLaneClear || (taskRequiredTimeUs < realtimeDelayUs)) {
+#if defined(USE_SCHEDULER_TASK_POOL)
+                // The task may cancel itself and reuse its slot, only release it if the generation is unchanged
+                const bool oneShot = selectedTask->taskFlags & TASK_FLAG_ONE_SHOT;
+                const uint8_t poolSlot = oneShot ? selectedTask - taskPool : 0;
+                const uint8_t poolSlotGeneration = poolGeneration[poolSlot];
+#endif
+                const timeUs_t backgroundExecutionTimeUs = schedulerExecuteTask(selectedTask, currentTimeUs);
+                taskExecutionTimeUs += backgroundExecutionTimeUs;
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+                if (isStretchable(selectedTask)) {
+                    overloadBusyUs += backgroundExecutionTimeUs;
+                }
+#endif
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+                heapUpdate(selectedTask);
+#elif defined(USE_SCHEDULER_SPLIT_TASKS)
+                queueUpdateDue(selectedTask);
+#endif
+#if defined(USE_SCHEDULER_TASK_POOL)
+                if (oneShot && poolGeneration[poolSlot] == poolSlotGeneration) {
+                    queueRemove(selectedTask);
+                    poolRelease(poolSlot);
+                }
+#endif
+#if defined(USE_SCHEDULER_TASK_CHAINS)
+                // Run the chain back to back while the guard window before the next realtime deadline has room
+                for (task_t *chainTask = chainNext(selectedTask); chainTask != NULL; chainTask = chainNext(chainTask)) {
+                    const timeUs_t chainTimeUs = micros();
+                    timeDelta_t chainRequiredTimeUs = TASK_AVERAGE_EXECUTE_FALLBACK_US;
+#if defined(USE_TASK_STATISTICS)
+                    if (calculateTaskStatistics) {
+                        chainRequiredTimeUs = taskStatistics(chainTask)->movingSumExecutionTimeUs / TASK_STATS_MOVING_SUM_COUNT + TASK_AVERAGE_EXECUTE_PADDING_US;
+                    }
+#endif
+                    if (chainRequiredTimeUs >= realtimeDelayUs - cmpTimeUs(chainTimeUs, currentTimeUs)) {
+                        break;
+                    }
+                    // Takes the signal, so the successor doesn't run again on the next pass
+                    updateEventTask(chainTask, chainTimeUs);
+                    taskEdges[taskState(chainTask)->triggerEdge - 1].samePassCount++;
+                    const timeUs_t chainExecutionTimeUs = schedulerExecuteTask(chainTask, chainTimeUs);
+                    taskExecutionTimeUs += chainExecutionTimeUs;
+                }
+#endif
             } else {
                 selectedTask = NULL;
             }
         }
     }
+
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+    updateOverloadGovernor(micros());
+#endif
+#if defined(USE_SCHEDULER_EXECUTOR)
+    // Draining only takes records off the ring, capturing tasks don't have to wait for the serial port
+    schedulerLockGuard.release();
+#endif
+
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+    // Nothing ran in the background this pass, use the spare time to push out log text
+    if (!selectedTask && (realtimeLaneClear || realtimeDelayUs > GUARD_INTERVAL_US + TASK_AVERAGE_EXECUTE_FALLBACK_US)) {
+        logDrain(SCHEDULER_LOG_DRAIN_BUDGET);
+    }
+#endif
+
+    // Tickless idle, nothing is waiting so sleep until the next task is due or a signal arrives
+    timeUs_t sleptUs = 0;
+    if (sleepFunc && !selectedTask && !signalPending()) {
+        const timeUs_t idleStartUs = micros();
+        const timeDelta_t sleepUs = idleTimeUs(idleStartUs) - GUARD_INTERVAL_US;
+        if (sleepUs >= SCHEDULER_MIN_SLEEP_US) {
+            sleepFunc(idleStartUs + sleepUs, &signalsPending);
+            sleptUs = micros() - idleStartUs;
+            idleInfo.sleepCount++;
+            idleInfo.totalSleepUs += sleptUs;
+        }
+    }
+#if defined(USE_SCHEDULER_LOAD_ACCOUNTING)
+    loadAccount(schedulerStartTimeUs, taskExecutionTimeUs, realtimeTaskRan || selectedTask, waitingTasks, sleptUs);
+#else
+    (void)sleptUs;
+#endif
+}
+
+#if defined(USE_SCHEDULER_LOAD_ACCOUNTING)
+/*
+ * Books the wall time since the end of the last pass. Whatever part of the pass
+ * was not spent in tasks, checkFuncs or the sleep hook is scheduler time: overhead
+ * when the pass ran a task, spin when it found nothing to do. A pass counts in
+ * the window it ends in.
+ */
+void Scheduler::loadAccount(timeUs_t passStartUs, timeUs_t taskUs, bool dispatched, uint16_t waitingTasks, timeUs_t sleptUs)
+{
+    const timeUs_t passEndUs = micros();
+    if (cmpTimeUs(passEndUs, loadWindowStartUs) >= SCHEDULER_LOAD_WINDOW_US) {
+        loadWindowIndex = (loadWindowIndex + 1) % SCHEDULER_LOAD_WINDOWS;
+        memset(&loadWindows[loadWindowIndex], 0, sizeof(loadWindows[loadWindowIndex]));
+        loadWindowStartUs = passEndUs;
+    }
+    loadWindow_t *window = &loadWindows[loadWindowIndex];
+    if (loadLastPassEndUs != 0) {
+        window->outsideUs += passStartUs - loadLastPassEndUs;
+    }
+    const timeDelta_t schedulerUs = MAX((timeDelta_t)0, cmpTimeUs(passEndUs, passStartUs) - (timeDelta_t)(taskUs + loadCheckFuncUs + sleptUs));
+    if (dispatched) {
+        window->overheadUs += schedulerUs;
+        window->dispatchPasses++;
+    } else {
+        window->spinUs += schedulerUs;
+    }
+    window->taskUs += taskUs;
+    window->checkFuncUs += loadCheckFuncUs;
+    window->idleUs += sleptUs;
+    window->passes++;
+    window->waitingTasks += waitingTasks;
+    loadCheckFuncUs = 0;
+    loadLastPassEndUs = passEndUs;
+}
+
+void Scheduler::getLoadInfo(loadInfo_t *loadInfo)
+{
+    memset(loadInfo, 0, sizeof(*loadInfo));
+    uint32_t waitingTasks = 0;
+    for (int ii = 0; ii < SCHEDULER_LOAD_WINDOWS; ii++) {
+        const loadWindow_t *window = &loadWindows[ii];
+        loadInfo->taskUs += window->taskUs;
+        loadInfo->checkFuncUs += window->checkFuncUs;
+        loadInfo->overheadUs += window->overheadUs;
+        loadInfo->spinUs += window->spinUs;
+        loadInfo->idleUs += window->idleUs;
+        loadInfo->outsideUs += window->outsideUs;
+        loadInfo->passes += window->passes;
+        loadInfo->dispatchPasses += window->dispatchPasses;
+        waitingTasks += window->waitingTasks;
+    }
+    loadInfo->windowUs = loadInfo->taskUs + loadInfo->checkFuncUs + loadInfo->overheadUs + loadInfo->spinUs + loadInfo->idleUs + loadInfo->outsideUs;
+    if (loadInfo->windowUs > 0) {
+        loadInfo->cpuLoadPercent = (uint64_t)(loadInfo->taskUs + loadInfo->checkFuncUs + loadInfo->overheadUs) * 100 / loadInfo->windowUs;
+        loadInfo->overheadPercent = (uint64_t)(loadInfo->overheadUs + loadInfo->spinUs) * 100 / loadInfo->windowUs;
+    }
+    if (loadInfo->passes > 0) {
+        loadInfo->averageWaitingTasksPercent = (uint64_t)waitingTasks * 100 / loadInfo->passes;
+    }
 }
+#endif
 
 #if defined(USE_TASK_STATISTICS)
 void Scheduler::getCheckFuncInfo(cfCheckFuncInfo_t *checkFuncInfo)
@@ -287,11 +1895,11 @@ void Scheduler::printTasks(void)
     int maxLoadSum = 0;
     int averageLoadSum = 0;
     Logln("Task list             rate/hz  max/us  avg/us maxload avgload  total/ms");
-    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+    for (int taskId = 0; taskId < taskCount; taskId++) {
         taskInfo_t taskInfo;
         getTaskInfo((taskId_e)taskId, &taskInfo);
         if (taskInfo.isEnabled) {
-            int taskFrequency = taskInfo.averageDeltaTimeUs == 0 ? 0 : lrintf(1e6f / taskInfo.averageDeltaTimeUs);
+            int taskFrequency = taskInfo.averageDeltaTimeUs == 0 ? 0 : (1000000 + taskInfo.averageDeltaTimeUs / 2) / taskInfo.averageDeltaTimeUs;
             Log("%02d - (%15s) ", taskId, taskInfo.taskName);
             const int maxLoad = taskInfo.maxExecutionTimeUs == 0 ? 0 :(taskInfo.maxExecutionTimeUs * taskFrequency + 5000) / 1000;
             const int averageLoad = taskInfo.averageExecutionTimeUs == 0 ? 0 : (taskInfo.averageExecutionTimeUs * taskFrequency + 5000) / 1000;
@@ -317,14 +1925,26 @@ void Scheduler::printTasks(void)
         Logln("Total%25d.%1d%% %4d.%1d%%", maxLoadSum/10, maxLoadSum%10, averageLoadSum/10, averageLoadSum%10);
         schedulerResetCheckFunctionMaxExecutionTime();
     #endif
+    #if defined(USE_SCHEDULER_LOAD_ACCOUNTING)
+        loadInfo_t loadInfo;
+        getLoadInfo(&loadInfo);
+        Logln("CPU load %d%%, scheduler overhead %d%% (%d us/dispatch), idle %d ms of %d ms",
+                loadInfo.cpuLoadPercent, loadInfo.overheadPercent,
+                loadInfo.dispatchPasses ? (int)(loadInfo.overheadUs / loadInfo.dispatchPasses) : 0,
+                (int)(loadInfo.idleUs / 1000), (int)(loadInfo.windowUs / 1000));
+    #endif
 }
 void Scheduler::schedulerResetTaskMaxExecutionTime(taskId_e taskId)
 {
 #if defined(USE_TASK_STATISTICS)
-    if (taskId == TASK_SELF) {
-        currentTask->maxExecutionTimeUs = 0;
-    } else if (taskId < TASK_COUNT) {
-        getTask(taskId)->maxExecutionTimeUs = 0;
+    if (taskId == TASK_SELF || taskId < taskCount) {
+        taskStatistics_t *stats = taskStatistics(taskId == TASK_SELF ? getCurrentTask() : getTask(taskId));
+        stats->maxExecutionTimeUs = 0;
+        stats->maxSignalLatencyUs = 0;
+        stats->maxRealtimeLatenessUs = 0;
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+        stats->maxBudgetOverrunUs = 0;
+#endif
     }
 #endif
 }
@@ -346,6 +1966,14 @@ void Scheduler::Log(const char *fmt, ...)
 
 void Scheduler::vprintln(const char *fmt, va_list argp)
 {
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+    if (debug_flag == true) {
+        logCapture(fmt, argp, true);
+    }
+#else
+#if defined(USE_SCHEDULER_SNAPSHOT)
+    snapshotFlush();    // a line inside a half sent frame would break it
+#endif
     char string[200];
     if(0 < vsprintf(string,fmt,argp)) // build string
     {
@@ -356,9 +1984,18 @@ void Scheduler::vprintln(const char *fmt, va_list argp)
         HAL_UART_Transmit_DMA(debug_uart, (uint8_t*)string, strlen(string));
 #endif
     }
+#endif
 }
 void Scheduler::vprint(const char *fmt, va_list argp)
 {
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+    if (debug_flag == true) {
+        logCapture(fmt, argp, false);
+    }
+#else
+#if defined(USE_SCHEDULER_SNAPSHOT)
+    snapshotFlush();
+#endif
     char string[200];
     if(0 < vsprintf(string,fmt,argp)) // build string
     {
@@ -369,25 +2006,79 @@ void Scheduler::vprint(const char *fmt, va_list argp)
         HAL_UART_Transmit_DMA(debug_uart, (uint8_t*)string, strlen(string));
 #endif
     }
+#endif
 }
 
 
 void Scheduler::getTaskInfo(taskId_e taskId, taskInfo_t * taskInfo)
 {
-    taskInfo->isEnabled = queueContains(getTask(taskId));
-    taskInfo->desiredPeriodUs = getTask(taskId)->desiredPeriodUs;
-    taskInfo->staticPriority = getTask(taskId)->staticPriority;
-    taskInfo->taskName = getTask(taskId)->taskName;
+    const task_t *task = getTask(taskId);
+    const taskState_t *state = taskState(task);
+    taskInfo->isEnabled = state->isQueued;
+    taskInfo->desiredPeriodUs = state->desiredPeriodUs;
+    taskInfo->staticPriority = task->staticPriority;
+    taskInfo->taskName = task->taskName;
 #if defined(USE_TASK_STATISTICS)
-    taskInfo->maxExecutionTimeUs = getTask(taskId)->maxExecutionTimeUs;
-    taskInfo->totalExecutionTimeUs = getTask(taskId)->totalExecutionTimeUs;
-    taskInfo->averageExecutionTimeUs = getTask(taskId)->movingSumExecutionTimeUs / TASK_STATS_MOVING_SUM_COUNT;
-    taskInfo->averageDeltaTimeUs = getTask(taskId)->movingSumDeltaTimeUs / TASK_STATS_MOVING_SUM_COUNT;
-    taskInfo->latestDeltaTimeUs = getTask(taskId)->taskLatestDeltaTimeUs;
-    taskInfo->movingAverageCycleTimeUs = getTask(taskId)->movingAverageCycleTimeUs;
+    const taskStatistics_t *stats = taskStatistics(task);
+    taskInfo->maxExecutionTimeUs = stats->maxExecutionTimeUs;
+    taskInfo->totalExecutionTimeUs = stats->totalExecutionTimeUs;
+    taskInfo->averageExecutionTimeUs = stats->movingSumExecutionTimeUs / TASK_STATS_MOVING_SUM_COUNT;
+    taskInfo->averageDeltaTimeUs = stats->movingSumDeltaTimeUs / TASK_STATS_MOVING_SUM_COUNT;
+    taskInfo->latestDeltaTimeUs = state->taskLatestDeltaTimeUs;
+#if defined(USE_TASK_STATISTICS_FIXED_POINT)
+    taskInfo->movingAverageCycleTimeUs = (stats->movingAverageCycleTimeQ4 + (1 << (TASK_STATS_CYCLE_TIME_FRACTION_BITS - 1))) >> TASK_STATS_CYCLE_TIME_FRACTION_BITS;
+#else
+    taskInfo->movingAverageCycleTimeUs = stats->movingAverageCycleTimeUs;
+#endif
+    taskInfo->latestSignalLatencyUs = stats->latestSignalLatencyUs;
+    taskInfo->maxSignalLatencyUs = stats->maxSignalLatencyUs;
+    taskInfo->realtimeLateCount = stats->realtimeLateCount;
+    taskInfo->latestRealtimeLatenessUs = stats->latestRealtimeLatenessUs;
+    taskInfo->maxRealtimeLatenessUs = stats->maxRealtimeLatenessUs;
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+    taskInfo->sliceCount = stats->sliceCount;
+    taskInfo->sliceOverrunCount = stats->sliceOverrunCount;
+    taskInfo->latestRunSlices = stats->latestRunSlices;
+    taskInfo->maxRunSlices = stats->maxRunSlices;
 #endif
+#endif
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+    taskInfo->nominalPeriodUs = state->nominalPeriodUs > 0 ? state->nominalPeriodUs : state->desiredPeriodUs;
+    taskInfo->budgetUs = state->budgetUs;
+    taskInfo->budgetOverrunCount = stats->budgetOverrunCount;
+    taskInfo->maxBudgetOverrunUs = stats->maxBudgetOverrunUs;
+#endif
+#if defined(USE_TASK_STATISTICS) && defined(USE_SCHEDULER_TASK_CHAINS)
+    taskInfo->latestChainLatencyUs = stats->latestChainLatencyUs;
+    taskInfo->maxChainLatencyUs = stats->maxChainLatencyUs;
+#endif
+#if defined(USE_SCHEDULER_ANCHORED_TIMING)
+    taskInfo->timing = state->timing;
+    taskInfo->missedReleases = state->missedReleases;
+    taskInfo->accumulatedDriftUs = state->accumulatedDriftUs;
+#endif
+}
+
+#if defined(USE_TASK_HISTOGRAMS)
+void Scheduler::getTaskHistogramInfo(taskId_e taskId, taskHistogramInfo_t *histogramInfo)
+{
+    if (taskId == TASK_SELF || taskId < taskCount) {
+        const taskStatistics_t *stats = taskStatistics((const task_t *)(taskId == TASK_SELF ? getCurrentTask() : getTask(taskId)));
+        taskHistogramPercentiles(&stats->executionTimeHistogram, &histogramInfo->executionTime);
+        taskHistogramPercentiles(&stats->startLatenessHistogram, &histogramInfo->startLateness);
+    }
 }
 
+void Scheduler::schedulerResetTaskHistograms(taskId_e taskId)
+{
+    if (taskId == TASK_SELF || taskId < taskCount) {
+        taskStatistics_t *stats = taskStatistics(taskId == TASK_SELF ? getCurrentTask() : getTask(taskId));
+        memset(&stats->executionTimeHistogram, 0, sizeof(stats->executionTimeHistogram));
+        memset(&stats->startLatenessHistogram, 0, sizeof(stats->startLatenessHistogram));
+    }
+}
+#endif
+
 #if defined(USE_TASK_STATISTICS)
 void Scheduler::schedulerResetCheckFunctionMaxExecutionTime(void)
 {
@@ -395,6 +2086,11 @@ void Scheduler::schedulerResetCheckFunctionMaxExecutionTime(void)
 }
 #endif
 
+uint16_t Scheduler::getAverageSystemLoadPercent(void)
+{
+    return averageSystemLoadPercent;
+}
+
 void Scheduler::debug(bool _dbg){
     debug_flag = _dbg;
 }
\ No newline at end of file
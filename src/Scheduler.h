@@ -7,6 +7,143 @@
 #define USE_TASK_STATISTICS
 #if defined(USE_TASK_STATISTICS)
 #define TASK_STATS_MOVING_SUM_COUNT 32
+// Integer only statistics for targets without an FPU, keeps soft-float out of
+// the dispatch path. TASK_PERIOD_HZ then takes an integer rate.
+// #define USE_TASK_STATISTICS_FIXED_POINT
+#if defined(USE_TASK_STATISTICS_FIXED_POINT)
+#define TASK_STATS_CYCLE_TIME_FRACTION_BITS 4   // moving average cycle time kept in 1/16 us
+#define TASK_STATS_CYCLE_TIME_ALPHA 13          // EMA weight in 1/256, 0.0508 against 0.05 for the float average, see README
+#define TASK_STATS_CYCLE_TIME_MAX_US (1L << 23) // longer cycles are clamped so the EMA step fits 32 bits
+#endif
+// Log-linear histograms of execution time and start lateness for every task,
+// about 300 bytes of RAM per task so leave it out on small targets
+// #define USE_TASK_HISTOGRAMS
+#endif
+#if defined(USE_TASK_HISTOGRAMS)
+#define TASK_HISTOGRAM_SUB_BUCKET_BITS 2    // 4 buckets per power of two, values within 25%
+#define TASK_HISTOGRAM_MAX_BITS 20          // values from 2^20 us (~1 s) up share the last bucket
+#define TASK_HISTOGRAM_BUCKETS ((TASK_HISTOGRAM_MAX_BITS - TASK_HISTOGRAM_SUB_BUCKET_BITS + 1) << TASK_HISTOGRAM_SUB_BUCKET_BITS)
+#endif
+// Keep time-driven tasks in a min-heap ordered by next due time instead of
+// scanning every queued task on each scheduler pass
+// #define USE_SCHEDULER_DEADLINE_QUEUE
+// Hot/cold task layout: task_t only holds the configuration and can be a const
+// table in flash, the scheduling state and the statistics live in the scheduler.
+// The linear scan reads the due times from compact arrays next to the queue, so
+// tasks that are not due yet are passed over untouched
+// #define USE_SCHEDULER_SPLIT_TASKS
+// Rule that picks among the waiting background tasks, see SchedulerPolicy.h:
+// SchedulerPolicyAging, SchedulerPolicyEdf or SchedulerPolicyRateMonotonic
+#if !defined(SCHEDULER_POLICY)
+#define SCHEDULER_POLICY SchedulerPolicyAging
+#endif
+// Resumable tasks, stackless coroutines that run in slices and yield before
+// the next realtime deadline, see DEFINE_RESUMABLE_TASK
+// #define USE_SCHEDULER_RESUMABLE_TASKS
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+#define SCHEDULER_MIN_SLICE_US 50       // a resumable task is only resumed with at least this much room
+#define SCHEDULER_MAX_SLICE_US 1000     // slice length when no realtime deadline limits it
+#endif
+// Fixed pool of runtime tasks for scheduleOnce()/scheduleEvery(), next to the task table
+// #define USE_SCHEDULER_TASK_POOL
+#if defined(USE_SCHEDULER_TASK_POOL)
+#if !defined(SCHEDULER_TASK_POOL_SIZE)
+#define SCHEDULER_TASK_POOL_SIZE 8      // at most 255
+#endif
+#endif
+// Host builds only: background tasks are handed to a SchedulerExecutor that runs
+// them on other threads, see extras/host/HostExecutor.h
+// #define USE_SCHEDULER_EXECUTOR
+#if defined(USE_SCHEDULER_EXECUTOR)
+#define SCHEDULER_EXECUTOR_POLL_US 100  // longest tickless sleep while tasks are out on the executor
+#define SCHEDULER_EXECUTOR_THREADS 9    // threads running tasks of one scheduler, the one calling run_scheduler() included
+#endif
+// Completion triggers, a task names successors that are signalled when it
+// returns and may run right after it in the same pass, see addTaskSuccessor()
+// #define USE_SCHEDULER_TASK_CHAINS
+#if defined(USE_SCHEDULER_TASK_CHAINS)
+#if defined(USE_SCHEDULER_EXECUTOR)
+#error "USE_SCHEDULER_TASK_CHAINS can not be used with USE_SCHEDULER_EXECUTOR"
+#endif
+#define SCHEDULER_MAX_SUCCESSORS 2      // per task
+#if !defined(SCHEDULER_MAX_TASK_EDGES)
+#define SCHEDULER_MAX_TASK_EDGES 8      // successor links in total, at most 255
+#endif
+#endif
+// Per-task timing mode, time-driven tasks can be due on a fixed grid of periods
+// instead of a period after their last start, see setTaskTiming()
+// #define USE_SCHEDULER_ANCHORED_TIMING
+// Time-driven tasks get their first due time spread across the period when
+// they are enabled or rescheduled, so tasks with equal or harmonic periods do
+// not all come due on the same pass
+// #define USE_SCHEDULER_PHASE_STAGGER
+#if defined(USE_SCHEDULER_PHASE_STAGGER)
+#define SCHEDULER_PHASE_CANDIDATES 16   // phases tried across one period
+#endif
+// Log/Logln only record the format string and raw arguments, formatting and
+// transmission happen in small chunks when the scheduler has nothing to run
+// #define USE_SCHEDULER_DEFERRED_LOG
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+#if !defined(SCHEDULER_LOG_BUFFER_SIZE)
+#define SCHEDULER_LOG_BUFFER_SIZE 512   // bytes, must be a power of two, printTasks() of 4 tasks takes about 300
+#endif
+#if !defined(SCHEDULER_LOG_LINE_SIZE)
+#define SCHEDULER_LOG_LINE_SIZE 128     // longest formatted line, longer lines are truncated
+#endif
+#define SCHEDULER_LOG_MAX_ARGS 10
+#if !defined(SCHEDULER_LOG_DRAIN_BUDGET)
+#define SCHEDULER_LOG_DRAIN_BUDGET 32   // bytes handed to the serial port per idle pass
+#endif
+#if !defined(SCHEDULER_LOG_FLUSH_TIMEOUT_US)
+#define SCHEDULER_LOG_FLUSH_TIMEOUT_US 100000   // logFlush() gives up when the port takes nothing for this long
+#endif
+#endif
+// Flight recorder of task, checkFunc, signal and realtime deadline miss events,
+// dumped with dumpTrace() and converted by extras/tools/trace2json.py
+// #define USE_SCHEDULER_TRACE
+#if defined(USE_SCHEDULER_TRACE)
+#if !defined(SCHEDULER_TRACE_SIZE)
+#define SCHEDULER_TRACE_SIZE 256        // events of 8 bytes, must be a power of two
+#endif
+#endif
+// Statistics of every enabled task copied into a packed binary frame in one
+// pass by takeSnapshot(), sent in chunks by streamSnapshot() and turned back
+// into the printTasks() table by extras/tools/snapshot2table.py
+// #define USE_SCHEDULER_SNAPSHOT
+#if defined(USE_SCHEDULER_SNAPSHOT)
+#if !defined(USE_TASK_STATISTICS)
+#error "USE_SCHEDULER_SNAPSHOT needs USE_TASK_STATISTICS"
+#endif
+#if !defined(SCHEDULER_SNAPSHOT_SIZE)
+#define SCHEDULER_SNAPSHOT_SIZE 512     // bytes per frame, two frames are kept
+#endif
+#if !defined(SCHEDULER_SNAPSHOT_STREAM_BUDGET)
+#define SCHEDULER_SNAPSHOT_STREAM_BUDGET 32 // bytes handed to the serial port per streamSnapshot() call
+#endif
+#endif
+// Splits wall time into task, checkFunc, scheduler overhead, spin and idle time
+// over a sliding window, see getLoadInfo()
+// #define USE_SCHEDULER_LOAD_ACCOUNTING
+#if defined(USE_SCHEDULER_LOAD_ACCOUNTING)
+#if !defined(USE_TASK_STATISTICS)
+#error "USE_SCHEDULER_LOAD_ACCOUNTING needs USE_TASK_STATISTICS"
+#endif
+#define SCHEDULER_LOAD_WINDOW_US 125000 // the sliding window moves in steps of this length
+#define SCHEDULER_LOAD_WINDOWS 8        // and covers the last this many steps
+#endif
+// Per-task execution budgets, and a governor that stretches the periods of low
+// priority tasks while their load is above the ceiling. Realtime and higher
+// priority tasks are protected, they neither count toward the load nor get stretched
+// #define USE_SCHEDULER_OVERLOAD_CONTROL
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+#if !defined(USE_TASK_STATISTICS)
+#error "USE_SCHEDULER_OVERLOAD_CONTROL needs USE_TASK_STATISTICS"
+#endif
+#define SCHEDULER_OVERLOAD_CEILING_PERCENT 80   // default ceiling, setOverloadCeiling() changes it
+#define SCHEDULER_OVERLOAD_HYSTERESIS_PERCENT 20   // periods are restored step by step below ceiling - hysteresis
+#define SCHEDULER_OVERLOAD_WINDOW_US 100000     // load is measured over windows of this length
+#define SCHEDULER_OVERLOAD_MAX_STRETCH 8        // stretched periods are at most this many times nominal
+#define SCHEDULER_OVERLOAD_STRETCH_PRIORITY TASK_PRIORITY_LOW  // time-driven tasks up to this priority get stretched
 #endif
 // time difference, 32 bits always sufficient
 typedef int32_t timeDelta_t;
@@ -21,34 +158,174 @@ typedef uint32_t timeUs_t;
 #define TIMEUS_MAX UINT32_MAX
 #endif
 
+#if defined(USE_TASK_STATISTICS_FIXED_POINT)
+#define TASK_PERIOD_HZ(hz) ((timeDelta_t(1000000) + timeDelta_t(hz) / 2) / timeDelta_t(hz))
+#else
 #define TASK_PERIOD_HZ(hz) (timeDelta_t(1000000) / float(hz))
+#endif
 #define TASK_PERIOD_MS(ms) (timeDelta_t(ms) * timeDelta_t(1000))
 #define TASK_PERIOD_US(us) (timeDelta_t(us))
 #define GUARD_INTERVAL_US 5
+#define REALTIME_LATE_LIMIT_US GUARD_INTERVAL_US   // realtime task starting later than this past its deadline counts as late
 #define SCHEDULER_DELAY_LIMIT           100
+#define SCHEDULER_MIN_SLEEP_US          50  // shorter idle gaps are not worth calling the sleep hook
 #define MAX(a,b) \
   __extension__ ({ __typeof__ (a) _a = (a); \
   __typeof__ (b) _b = (b); \
   _a > _b ? _a : _b; })
+#define MIN(a,b) \
+  __extension__ ({ __typeof__ (a) _a = (a); \
+  __typeof__ (b) _b = (b); \
+  _a < _b ? _a : _b; })
 static inline timeDelta_t cmpTimeUs(timeUs_t a, timeUs_t b) { return (timeDelta_t)(a - b); }
 
 
-#if defined(USE_TASK_STATISTICS)
+// The period is the only field task_t and its scheduling state share
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+#define TASK_PERIOD_FIELD(desiredPeriodParam) .desiredPeriodUs = desiredPeriodParam
+#else
+#define TASK_PERIOD_FIELD(desiredPeriodParam) .state = { .desiredPeriodUs = desiredPeriodParam }
+#endif
+
 #define DEFINE_TASK(taskNameParam, checkFuncParam, taskFuncParam, desiredPeriodParam, staticPriorityParam) {  \
     .taskName = taskNameParam, \
     .checkFunc = checkFuncParam, \
     .taskFunc = taskFuncParam, \
-    .desiredPeriodUs = desiredPeriodParam, \
-    .staticPriority = staticPriorityParam \
+    .staticPriority = staticPriorityParam, \
+    TASK_PERIOD_FIELD(desiredPeriodParam) \
 }
-#else
-#define DEFINE_TASK(taskNameParam, checkFuncParam, taskFuncParam, desiredPeriodParam, staticPriorityParam) {  \
+
+// Task signalled with Scheduler::signalTask() instead of polling a checkFunc,
+// the period only sets how fast the task ages while it waits to run
+#define DEFINE_SIGNAL_TASK(taskNameParam, taskFuncParam, desiredPeriodParam, staticPriorityParam) {  \
     .taskName = taskNameParam, \
-    .checkFunc = checkFuncParam, \
+    .checkFunc = NULL, \
     .taskFunc = taskFuncParam, \
-    .desiredPeriodUs = desiredPeriodParam, \
-    .staticPriority = staticPriorityParam \
+    .staticPriority = staticPriorityParam, \
+    .taskFlags = TASK_FLAG_SIGNAL_DRIVEN, \
+    TASK_PERIOD_FIELD(desiredPeriodParam) \
 }
+
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+/*
+ * Resumable task, protothread style. The body sits between TASK_BEGIN and
+ * TASK_END and can give the CPU back with TASK_YIELD, TASK_YIELD_IF_SLICE_OVER,
+ * TASK_YIELD_IF_NO_ROOM, TASK_AWAIT_DELAY or TASK_AWAIT_SIGNAL. Local variables do not survive a
+ * yield, keep state in statics or in the object the task works on. A switch
+ * statement can not span a yield.
+ *
+ *   taskResume_e taskFlash(taskCoroutine_t *co, timeUs_t currentTimeUs) {
+ *       static int page;
+ *       TASK_BEGIN(co);
+ *       for (page = 0; page < 16; page++) {
+ *           TASK_YIELD_IF_NO_ROOM(co, PAGE_WRITE_US);
+ *           writePage(page);
+ *       }
+ *       TASK_AWAIT_DELAY(co, TASK_PERIOD_MS(5));
+ *       TASK_END(co);
+ *   }
+ */
+#define DEFINE_RESUMABLE_TASK(taskNameParam, resumeFuncParam, desiredPeriodParam, staticPriorityParam) {  \
+    .taskName = taskNameParam, \
+    .checkFunc = NULL, \
+    .taskFunc = NULL, \
+    .staticPriority = staticPriorityParam, \
+    .taskFlags = 0, \
+    .resumeFunc = resumeFuncParam, \
+    TASK_PERIOD_FIELD(desiredPeriodParam) \
+}
+
+typedef enum {
+    TASK_YIELDED,   // more work to do, resume as soon as there is room
+    TASK_WAITING,   // resume at resumeAtUs, or on a signal when awaiting one
+    TASK_DONE       // run finished, the next one starts a period after this one started
+} taskResume_e;
+
+typedef struct {
+    uint16_t resumePoint;       // line of the last yield, 0 between runs
+    bool awaitingSignal;
+    bool signalled;             // the last TASK_AWAIT_SIGNAL ended with a signal, not the timeout
+    timeUs_t resumeAtUs;        // earliest time of the next slice
+    timeUs_t sliceEndUs;        // set before every slice, the task should yield once it is reached
+    timeUs_t runStartedAtUs;    // first slice of the current or last run
+} taskCoroutine_t;
+
+#define TASK_BEGIN(co) switch ((co)->resumePoint) { case 0:
+#define TASK_YIELD(co) do { (co)->resumePoint = __LINE__; return TASK_YIELDED; case __LINE__:; } while (0)
+#define TASK_YIELD_IF_SLICE_OVER(co) do { if (cmpTimeUs(micros(), (co)->sliceEndUs) >= 0) { TASK_YIELD(co); } } while (0)
+// Waits for a slice with neededUs of room left, neededUs must stay below the shortest slice the task gets
+#define TASK_YIELD_IF_NO_ROOM(co, neededUs) do { \
+    (co)->resumePoint = __LINE__; case __LINE__: \
+    if (cmpTimeUs((co)->sliceEndUs, micros()) < (timeDelta_t)(neededUs)) { return TASK_YIELDED; } } while (0)
+#define TASK_AWAIT_DELAY(co, delayUs) do { \
+    (co)->resumeAtUs = micros() + (delayUs); \
+    (co)->resumePoint = __LINE__; return TASK_WAITING; case __LINE__:; } while (0)
+#define TASK_AWAIT_SIGNAL(co, timeoutUs) do { \
+    (co)->resumeAtUs = micros() + (timeoutUs); \
+    (co)->awaitingSignal = true; \
+    (co)->resumePoint = __LINE__; return TASK_WAITING; case __LINE__:; } while (0)
+#define TASK_END(co) } (co)->resumePoint = 0; return TASK_DONE
+#endif
+
+#if defined(USE_TASK_HISTOGRAMS)
+typedef struct {
+    uint16_t bucket[TASK_HISTOGRAM_BUCKETS];   // halved together when one saturates
+    uint32_t samples;
+    timeUs_t maxValueUs;
+} taskHistogram_t;
+#endif
+
+#if defined(USE_TASK_STATISTICS)
+// Written when a task ran, read by getTaskInfo(). Part of task_t, or with
+// USE_SCHEDULER_SPLIT_TASKS of a table inside the scheduler.
+typedef struct {
+#if defined(USE_TASK_STATISTICS_FIXED_POINT)
+    timeDelta_t movingAverageCycleTimeQ4;  // fixed point, TASK_STATS_CYCLE_TIME_FRACTION_BITS
+#else
+    float    movingAverageCycleTimeUs;
+#endif
+    timeUs_t movingSumExecutionTimeUs;  // moving sum over 32 samples
+    timeUs_t movingSumDeltaTimeUs;  // moving sum over 32 samples
+    timeUs_t maxExecutionTimeUs;
+    timeUs_t totalExecutionTimeUs;    // total time consumed by task since boot
+    timeDelta_t latestSignalLatencyUs;  // event-driven tasks, time from signal to start of execution
+    timeDelta_t maxSignalLatencyUs;
+    uint32_t realtimeLateCount;         // realtime tasks, starts later than REALTIME_LATE_LIMIT_US past the deadline
+    timeDelta_t latestRealtimeLatenessUs;
+    timeDelta_t maxRealtimeLatenessUs;
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+    uint32_t sliceCount;                // resumable tasks, the execution statistics above are per slice
+    uint32_t sliceOverrunCount;         // slices still running at sliceEndUs
+    uint16_t runSlices;                 // slices of the run in progress
+    uint16_t latestRunSlices;
+    uint16_t maxRunSlices;
+#endif
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+    uint32_t budgetOverrunCount;        // runs longer than budgetUs
+    timeDelta_t maxBudgetOverrunUs;
+#endif
+#if defined(USE_SCHEDULER_TASK_CHAINS)
+    timeDelta_t latestChainLatencyUs;   // last task of a chain, start of the first task to own end
+    timeDelta_t maxChainLatencyUs;
+#endif
+#if defined(USE_TASK_HISTOGRAMS)
+    taskHistogram_t executionTimeHistogram;
+    taskHistogram_t startLatenessHistogram;  // start time after the task became due, or after the signal
+#endif
+} taskStatistics_t;
+#endif
+
+typedef enum {
+    TASK_FLAG_SIGNAL_DRIVEN = (1 << 0),  // Task only becomes ready through signalTask()
+    TASK_FLAG_ONE_SHOT = (1 << 1),       // Pool task that is released after it ran once
+} taskFlag_e;
+
+#if defined(USE_SCHEDULER_ANCHORED_TIMING)
+typedef enum {
+    TASK_TIMING_RELATIVE = 0,   // due a period after the last start, a late start delays all later runs
+    TASK_TIMING_ANCHORED,       // due on a fixed grid of periods, releases missed while late are skipped
+    TASK_TIMING_CATCH_UP,       // fixed grid, missed releases run back to back, at most catchUpLimit of them
+} taskTiming_e;
 #endif
 
 typedef enum {
@@ -61,29 +338,74 @@ typedef enum {
     TASK_PRIORITY_MAX = 255
 } taskPriority_e;
 
+// Everything the scheduler changes while a task is enabled, see Scheduler::taskState()
 typedef struct {
-    // Configuration
-    const char * taskName;
-    bool (*checkFunc)(timeUs_t currentTimeUs, timeDelta_t currentDeltaTimeUs);
-    void (*taskFunc)(timeUs_t currentTimeUs);
     timeDelta_t desiredPeriodUs;      // target period of execution
-    const int8_t staticPriority;    // dynamicPriority grows in steps of this size
-
-    // Scheduling
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+    taskCoroutine_t coroutine;
+#endif
     uint16_t dynamicPriority;       // measurement of how old task was last executed, used to avoid task starvation
     uint16_t taskAgeCycles;
     timeDelta_t taskLatestDeltaTimeUs;
     timeUs_t lastExecutedAtUs;        // last time of invocation
     timeUs_t lastSignaledAtUs;        // time of invocation event for event-driven tasks
     timeUs_t lastDesiredAt;         // time of last desired execution
+    bool isQueued;                  // in the task queue, keeps queueContains() O(1)
+    bool realtimeRanThisPass;       // already had its turn in the realtime lane of the current pass
+#if defined(USE_SCHEDULER_ANCHORED_TIMING)
+    uint8_t timing;                 // taskTiming_e
+    uint8_t catchUpLimit;           // TASK_TIMING_CATCH_UP, missed releases kept for back to back runs
+    uint32_t missedReleases;        // releases that never got a run of their own
+    uint64_t accumulatedDriftUs;    // sum of the delays late starts pushed onto later runs
+#endif
+#if defined(USE_SCHEDULER_EXECUTOR)
+    bool inFlight;                  // handed to the executor and not collected yet, the scheduler keeps its hands off
+#endif
+#if defined(USE_SCHEDULER_TASK_CHAINS)
+    uint8_t successorCount;
+    uint8_t successorEdges[SCHEDULER_MAX_SUCCESSORS];  // into the scheduler's edge table
+    uint8_t triggerEdge;            // edge + 1 that signalled the task, 0 if none
+    timeUs_t chainStartedAtUs;      // start of the first task of the chain this run is part of
+    uint32_t chainInput;            // payload of the upstream task, see getTaskInput()
+    uint32_t chainOutput;           // payload for the successors, see setTaskOutput()
+#endif
+    volatile uint8_t signalPending;     // set by signalTask(), possibly from an interrupt
+    volatile timeUs_t signalPendingAtUs; // time signalTask() was called
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+    timeUs_t nextDueAtUs;           // deadline heap key, time the task becomes due
+    int16_t heapIndex;              // position inside the deadline heap
+    int16_t queueIndex;             // position in the queue, keeps queueRemove() O(log n)
+#elif defined(USE_SCHEDULER_SPLIT_TASKS)
+    int16_t queueIndex;             // position in the queue and its compact due time arrays
+#endif
+
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+    timeDelta_t budgetUs;           // execution time allowed per run, 0 for none
+    timeDelta_t nominalPeriodUs;    // period before the governor stretched it, 0 while not stretched
+#endif
+} taskState_t;
+
+typedef struct {
+    // Configuration
+    const char * taskName;
+    bool (*checkFunc)(timeUs_t currentTimeUs, timeDelta_t currentDeltaTimeUs);
+    void (*taskFunc)(timeUs_t currentTimeUs);
+    const int8_t staticPriority;    // dynamicPriority grows in steps of this size
+    uint8_t taskFlags;              // taskFlag_e bits
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+    taskResume_e (*resumeFunc)(taskCoroutine_t *co, timeUs_t currentTimeUs);  // replaces taskFunc for resumable tasks
+#endif
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+    timeDelta_t desiredPeriodUs;    // the state starts from it in Scheduler::resetTaskStates()
+#else
+
+    // Scheduling
+    taskState_t state;
 
 #if defined(USE_TASK_STATISTICS)
     // Statistics
-    float    movingAverageCycleTimeUs;
-    timeUs_t movingSumExecutionTimeUs;  // moving sum over 32 samples
-    timeUs_t movingSumDeltaTimeUs;  // moving sum over 32 samples
-    timeUs_t maxExecutionTimeUs;
-    timeUs_t totalExecutionTimeUs;    // total time consumed by task since boot
+    taskStatistics_t statistics;
+#endif
 #endif
 } task_t;
 
@@ -98,7 +420,37 @@ typedef struct {
     timeUs_t     totalExecutionTimeUs;
     timeUs_t     averageExecutionTimeUs;
     timeUs_t     averageDeltaTimeUs;
+#if defined(USE_TASK_STATISTICS_FIXED_POINT)
+    timeUs_t     movingAverageCycleTimeUs;
+#else
     float        movingAverageCycleTimeUs;
+#endif
+    timeDelta_t  latestSignalLatencyUs;
+    timeDelta_t  maxSignalLatencyUs;
+    uint32_t     realtimeLateCount;
+    timeDelta_t  latestRealtimeLatenessUs;
+    timeDelta_t  maxRealtimeLatenessUs;
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+    uint32_t     sliceCount;
+    uint32_t     sliceOverrunCount;
+    uint16_t     latestRunSlices;
+    uint16_t     maxRunSlices;
+#endif
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+    timeDelta_t  nominalPeriodUs;
+    timeDelta_t  budgetUs;
+    uint32_t     budgetOverrunCount;
+    timeDelta_t  maxBudgetOverrunUs;
+#endif
+#if defined(USE_SCHEDULER_TASK_CHAINS)
+    timeDelta_t  latestChainLatencyUs;
+    timeDelta_t  maxChainLatencyUs;
+#endif
+#if defined(USE_SCHEDULER_ANCHORED_TIMING)
+    uint8_t      timing;
+    uint32_t     missedReleases;
+    uint64_t     accumulatedDriftUs;
+#endif
 } taskInfo_t;
 
 typedef struct {
@@ -108,7 +460,142 @@ typedef struct {
     timeUs_t     averageDeltaTimeUs;
 } cfCheckFuncInfo_t;
 
+#if defined(USE_TASK_HISTOGRAMS)
+typedef struct {
+    uint32_t     samples;
+    timeUs_t     p50Us;         // percentiles are the upper edge of the bucket they fall in
+    timeUs_t     p90Us;
+    timeUs_t     p99Us;
+    timeUs_t     maxUs;
+} taskPercentiles_t;
+
+typedef struct {
+    taskPercentiles_t executionTime;
+    taskPercentiles_t startLateness;
+} taskHistogramInfo_t;
+#endif
+
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+typedef struct {
+    uint32_t     capturedRecords;
+    uint32_t     droppedRecords;    // Log calls lost because the ring was full, a line is dropped as a whole
+    uint32_t     overflowEvents;    // times the ring filled up
+    uint32_t     truncatedLines;    // lines longer than SCHEDULER_LOG_LINE_SIZE
+    uint16_t     maxUsedBytes;      // high water mark of the ring
+} logInfo_t;
+#endif
+
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+typedef struct {
+    uint8_t      utilizationPercent;    // background task load over the last window
+    uint16_t     stretchPercent;        // stretched periods relative to nominal, 100 when not stretching
+    uint32_t     overloadWindows;       // windows with the load above the ceiling
+} overloadInfo_t;
+#endif
+
+#if defined(USE_SCHEDULER_LOAD_ACCOUNTING)
+typedef struct {
+    timeUs_t     taskUs;
+    timeUs_t     checkFuncUs;
+    timeUs_t     overheadUs;
+    timeUs_t     spinUs;
+    timeUs_t     idleUs;
+    timeUs_t     outsideUs;
+    uint32_t     passes;
+    uint32_t     dispatchPasses;
+    uint32_t     waitingTasks;
+} loadWindow_t;
+
+typedef struct {
+    timeUs_t     windowUs;          // wall time covered, the sum of the times below
+    timeUs_t     taskUs;            // in task functions on the scheduler's thread
+    timeUs_t     checkFuncUs;       // in checkFuncs
+    timeUs_t     overheadUs;        // scheduler bookkeeping in passes that ran a task
+    timeUs_t     spinUs;            // passes that found nothing to run
+    timeUs_t     idleUs;            // in the sleep hook
+    timeUs_t     outsideUs;         // between passes, outside run_scheduler()
+    uint32_t     passes;
+    uint32_t     dispatchPasses;    // passes that ran at least one task
+    uint8_t      cpuLoadPercent;    // task, checkFunc and overhead time
+    uint8_t      overheadPercent;   // overhead and spin time
+    uint16_t     averageWaitingTasksPercent;    // 100 times the tasks waiting per pass, the load before
+} loadInfo_t;
+#endif
+
+#if defined(USE_SCHEDULER_SNAPSHOT)
+#define SNAPSHOT_FRAME_VERSION 1
+#define SNAPSHOT_FLAG_TRUNCATED (1 << 0)        // not every enabled task fitted into SCHEDULER_SNAPSHOT_SIZE
+#define SNAPSHOT_FLAG_MAX_RESET (1 << 1)        // max values were reset after they were copied
+#define SNAPSHOT_FLAG_LOAD_ACCOUNTING (1 << 2)  // cpuLoadPercent and overheadPercent are set
+
+// Frame header, followed by taskRecordCount snapshotTask_t and then their names, NUL terminated
+typedef struct {
+    char         magic[4];          // "SSNP"
+    uint8_t      version;           // SNAPSHOT_FRAME_VERSION
+    uint8_t      flags;             // SNAPSHOT_FLAG_ bits
+    uint8_t      taskRecordSize;    // sizeof(snapshotTask_t)
+    uint8_t      taskRecordCount;
+    uint32_t     sequence;          // frames taken since boot
+    uint32_t     timeUs;
+    uint16_t     frameBytes;        // header, records and names
+    uint16_t     checksum;          // sum of all frame bytes, counting this field as 0
+    uint32_t     checkFuncMaxExecutionTimeUs;
+    uint32_t     checkFuncAverageExecutionTimeUs;
+    uint32_t     checkFuncTotalExecutionTimeUs;
+    uint16_t     averageSystemLoadPercent;
+    uint8_t      cpuLoadPercent;
+    uint8_t      overheadPercent;
+} snapshotHeader_t;
+
+typedef struct {
+    uint16_t     taskId;
+    int8_t       staticPriority;
+    uint8_t      taskFlags;
+    int32_t      desiredPeriodUs;
+    uint32_t     maxExecutionTimeUs;
+    uint32_t     averageExecutionTimeUs;
+    uint32_t     averageDeltaTimeUs;
+    uint32_t     totalExecutionTimeUs;
+    int32_t      latestDeltaTimeUs;
+    int32_t      maxSignalLatencyUs;
+    uint32_t     realtimeLateCount;
+    int32_t      maxRealtimeLatenessUs;
+} snapshotTask_t;
+
+typedef struct {
+    uint32_t     takenFrames;
+    uint32_t     sentFrames;
+    uint32_t     replacedFrames;    // taken again before streamSnapshot() got to send them
+    uint32_t     truncatedFrames;
+    uint16_t     maxFrameBytes;
+} snapshotInfo_t;
+#endif
+
+#if defined(USE_SCHEDULER_TASK_POOL)
+// Pool slot in the low byte, generation in the high byte, stale handles are refused
+typedef uint16_t taskHandle_t;
+#define TASK_HANDLE_NONE 0
+
+typedef struct {
+    uint8_t      used;
+    uint8_t      maxUsed;
+    uint32_t     allocationFailures;    // schedule calls refused because the pool was full
+} taskPoolInfo_t;
+#endif
+
+// Tickless idle hook, sleeps until wakeAtUs or until *signalPending is set by signalTask()
+typedef void (*schedulerSleepFunc_t)(timeUs_t wakeAtUs, const volatile uint8_t *signalPending);
+
+typedef struct {
+    uint32_t     sleepCount;
+    timeUs_t     totalSleepUs;      // time spent inside the sleep hook
+} idleInfo_t;
+
 // this should be modified and in order with the main file
+// or supplied by the application with -DSCHEDULER_TASK_IDS='"myTaskIds.h"'
+#if defined(SCHEDULER_TASK_IDS)
+#include SCHEDULER_TASK_IDS
+#else
 typedef enum {
     /* Actual tasks */
     TASK_SYSTEM = 0,
@@ -121,24 +608,144 @@ typedef enum {
     TASK_NONE = TASK_COUNT,
     TASK_SELF
 } taskId_e;
+#endif
 
 
 extern task_t tasks[TASK_COUNT];
 
+#if defined(USE_SCHEDULER_TASK_CHAINS)
+typedef struct {
+    taskId_e     taskId;
+    taskId_e     successorId;
+    uint32_t     triggerCount;      // runs of taskId that signalled successorId
+    uint32_t     samePassCount;     // successor ran right after taskId, in the same pass
+    timeDelta_t  latestLatencyUs;   // end of taskId to start of successorId
+    timeDelta_t  maxLatencyUs;
+    timeUs_t     movingSumLatencyUs;
+} taskEdge_t;
+
+typedef struct {
+    taskId_e     taskId;
+    taskId_e     successorId;
+    uint32_t     triggerCount;
+    uint32_t     samePassCount;
+    timeDelta_t  latestLatencyUs;
+    timeDelta_t  maxLatencyUs;
+    timeDelta_t  averageLatencyUs;
+} taskEdgeInfo_t;
+#endif
+
+#if defined(USE_SCHEDULER_TRACE)
+typedef enum {
+    TRACE_TASK_START = 0,
+    TRACE_TASK_END,
+    TRACE_CHECK_START,
+    TRACE_CHECK_END,            // arg is 1 if the checkFunc made the task ready
+    TRACE_SIGNAL,
+    TRACE_DEADLINE_MISS,        // arg is the lateness in us, clamped to 65535
+} traceEventType_e;
+
+#define TRACE_NO_TASK 0xFF
+#define TRACE_BLOB_VERSION 2
+#define TRACE_TYPE_MASK 0x0F
+#define TRACE_THREAD_SHIFT 4
+#define TRACE_OTHER_THREAD 0x0F     // recorded by a thread that never ran a task, or the table was full
+#if defined(USE_SCHEDULER_EXECUTOR) && SCHEDULER_EXECUTOR_THREADS > TRACE_OTHER_THREAD
+#error "the trace keeps at most 15 threads apart, reduce SCHEDULER_EXECUTOR_THREADS"
+#endif
+
+// Stored and dumped as is, little-endian on every supported target
+typedef struct {
+    uint32_t timeUs;
+    uint8_t type;               // traceEventType_e, the recording thread in the upper 4 bits
+    uint8_t taskIndex;          // task table index, pool slots follow the table
+    uint16_t arg;
+} traceEvent_t;
+
+typedef struct {
+    uint32_t recordedEvents;    // since the last reset, the ring holds the newest SCHEDULER_TRACE_SIZE
+    bool enabled;
+} traceInfo_t;
+
+#define SCHEDULER_TRACE(type, task, timeUs, arg) traceRecord(type, task, timeUs, arg)
+#else
+#define SCHEDULER_TRACE(type, task, timeUs, arg)
+#endif
+
+#if defined(USE_SCHEDULER_EXECUTOR)
+/*
+ * Runs background tasks away from the thread calling run_scheduler(). A ready
+ * task is handed over with submit() and comes back through completed() once
+ * it returned, it is never submitted again while it is out. lock()/unlock()
+ * must be recursive, they keep the queues consistent when tasks call the
+ * scheduler from other threads.
+ */
+class SchedulerExecutor
+{
+    public:
+        virtual ~SchedulerExecutor() {}
+        virtual bool submit(task_t *task, timeUs_t currentTimeUs) = 0;  // false when it can take no more
+        virtual task_t *completed(timeUs_t *executionTimeUs) = 0;       // next finished task, NULL if none
+        virtual void lock(void) = 0;
+        virtual void unlock(void) = 0;
+};
+
+// Holds the executor lock for a scope, does nothing while no executor is set
+class SchedulerLockGuard
+{
+    public:
+        SchedulerLockGuard(SchedulerExecutor *executor) : executor(executor) { if (executor) { executor->lock(); } }
+        ~SchedulerLockGuard() { release(); }
+        void release(void) { if (executor) { executor->unlock(); executor = NULL; } }
+    private:
+        SchedulerExecutor *executor;
+};
+#define SCHEDULER_LOCK() SchedulerLockGuard schedulerLockGuard(executor)
+#else
+#define SCHEDULER_LOCK()
+#endif
+
+#if defined(USE_SCHEDULER_TASK_POOL)
+#define SCHEDULER_QUEUE_CAPACITY (TASK_COUNT + SCHEDULER_TASK_POOL_SIZE)
+#else
+#define SCHEDULER_QUEUE_CAPACITY TASK_COUNT
+#endif
+
 class Scheduler
 {
     public:
-        Scheduler();
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+        // Only read, so the table can be const
+        Scheduler(const task_t *taskTable = tasks, int taskCount = TASK_COUNT);
+#else
+        Scheduler(task_t *taskTable = tasks, int taskCount = TASK_COUNT);
+#endif
         void run_scheduler(void);
         task_t* getTask(unsigned taskId);
         timeUs_t schedulerExecuteTask(task_t *selectedTask, timeUs_t currentTimeUs);
         void taskSystemLoad(timeUs_t currentTimeUs);
+        uint16_t getAverageSystemLoadPercent(void);
         void setTaskEnabled(taskId_e taskId, bool enabled);
+        void signalTask(taskId_e taskId);
+        bool signalPending(void);
+        void setSleepFunc(schedulerSleepFunc_t sleepFunc);
+#if defined(USE_SCHEDULER_EXECUTOR)
+        void setExecutor(SchedulerExecutor *executor);
+#endif
+        timeDelta_t idleTimeUs(timeUs_t currentTimeUs);
+        void getIdleInfo(idleInfo_t *idleInfo);
         void rescheduleTask(taskId_e taskId, timeDelta_t newPeriodUs);
+        timeDelta_t getTaskPeriodUs(taskId_e taskId);
+#if defined(USE_SCHEDULER_ANCHORED_TIMING)
+        void setTaskTiming(taskId_e taskId, taskTiming_e timing, uint8_t catchUpLimit = 0);
+#endif
         void getTaskInfo(taskId_e taskId, taskInfo_t * taskInfo);
         void schedulerResetTaskMaxExecutionTime(taskId_e taskId);
         void printTasks(void);
         void queueClear(void);
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+        void resetTaskStates(void);     // after the task table was filled in at run time
+#endif
         bool queueContains(task_t *task);
         bool queueAdd(task_t *task);
         bool queueRemove(task_t *task);
@@ -150,11 +757,288 @@ class Scheduler
         task_t* queueFirst(void);
         task_t* queueNext(void);
         int taskQueueSize = 0;
-        task_t* taskQueueArray[TASK_COUNT + 1]; // extra item for NULL pointer at end of queue
+        task_t* taskQueueArray[SCHEDULER_QUEUE_CAPACITY + 1] = {}; // extra item for NULL pointer at end of queue, by falling priority except with the deadline queue
         #ifdef USE_TASK_STATISTICS
         void getCheckFuncInfo(cfCheckFuncInfo_t *checkFuncInfo);
         void schedulerResetCheckFunctionMaxExecutionTime(void);
+#if defined(USE_SCHEDULER_LOAD_ACCOUNTING)
+        void getLoadInfo(loadInfo_t *loadInfo);
+#endif
         #endif
+#if defined(USE_TASK_HISTOGRAMS)
+        void getTaskHistogramInfo(taskId_e taskId, taskHistogramInfo_t *histogramInfo);
+        void schedulerResetTaskHistograms(taskId_e taskId);
+#endif
+#if defined(USE_SCHEDULER_TASK_POOL)
+        taskHandle_t scheduleOnce(void (*taskFunc)(timeUs_t currentTimeUs), timeDelta_t delayUs, int8_t priority = TASK_PRIORITY_MEDIUM);
+        taskHandle_t scheduleEvery(void (*taskFunc)(timeUs_t currentTimeUs), timeDelta_t periodUs, int8_t priority);
+        bool cancel(taskHandle_t handle);
+        void getTaskPoolInfo(taskPoolInfo_t *poolInfo);
+#endif
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+        void setTaskBudget(taskId_e taskId, timeDelta_t budgetUs);
+        void setOverloadCeiling(uint8_t ceilingPercent);
+        void getOverloadInfo(overloadInfo_t *overloadInfo);
+#endif
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+        void logDrain(uint16_t budgetBytes);
+        bool logFlush(void);
+        void getLogInfo(logInfo_t *logInfo);
+#endif
+#if defined(USE_SCHEDULER_TASK_CHAINS)
+        bool addTaskSuccessor(taskId_e taskId, taskId_e successorId);
+        void setTaskOutput(uint32_t payload);
+        uint32_t getTaskInput(void);
+        int getTaskEdgeCount(void);
+        void getTaskEdgeInfo(int edge, taskEdgeInfo_t *edgeInfo);
+#endif
+#if defined(USE_SCHEDULER_SNAPSHOT)
+        uint16_t takeSnapshot(bool resetMax = true);
+        bool streamSnapshot(uint16_t budgetBytes = SCHEDULER_SNAPSHOT_STREAM_BUDGET);
+        void getSnapshotInfo(snapshotInfo_t *snapshotInfo);
+#endif
+#if defined(USE_SCHEDULER_TRACE)
+        void setTraceEnabled(bool enabled);
+        void setTraceStopOnMiss(bool enabled);
+        void resetTrace(void);
+        uint16_t getTraceEvents(traceEvent_t *events, uint16_t maxEvents);
+        void getTraceInfo(traceInfo_t *traceInfo);
+        void dumpTrace(void);
+#endif
     private:
+        task_t *taskTable;
+        int taskCount;
+        int taskQueuePos = 0;
+#if defined(USE_SCHEDULER_EXECUTOR)
+        struct {
+            const void *thread;         // see setCurrentTask()
+            task_t *task;
+        } currentTasks[SCHEDULER_EXECUTOR_THREADS] = {};
+#else
+        task_t *currentTask = NULL;
+#endif
+        task_t *getCurrentTask(void);
+        void setCurrentTask(task_t *task);
+#if defined(USE_SCHEDULER_EXECUTOR)
+        int threadSlot(void) const;
+#endif
+        bool calculateTaskStatistics = true;
+        int taskIndex(const task_t *task) const;
+        taskState_t *taskState(task_t *task);
+        const taskState_t *taskState(const task_t *task) const;
+#if defined(USE_TASK_STATISTICS)
+        taskStatistics_t *taskStatistics(task_t *task);
+        const taskStatistics_t *taskStatistics(const task_t *task) const;
+#endif
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+        taskState_t taskStates[SCHEDULER_QUEUE_CAPACITY];   // by taskIndex()
+#if defined(USE_TASK_STATISTICS)
+        taskStatistics_t taskStatisticsTable[SCHEDULER_QUEUE_CAPACITY];
+#endif
+#endif
+        uint16_t averageSystemLoadPercent = 0;
+        uint32_t totalWaitingTasks = 0;
+        uint32_t totalWaitingTasksSamples = 0;
+#if defined(USE_TASK_STATISTICS)
+        timeUs_t checkFuncMaxExecutionTimeUs = 0;
+        timeUs_t checkFuncTotalExecutionTimeUs = 0;
+        timeUs_t checkFuncMovingSumExecutionTimeUs = 0;
+        timeUs_t checkFuncMovingSumDeltaTimeUs = 0;
+#endif
         bool debug_flag=false;
-};
\ No newline at end of file
+        bool updateEventTask(task_t *task, timeUs_t currentTimeUs);
+        bool callCheckFunc(task_t *task, timeUs_t currentTimeUs);
+        void runTaskFunc(task_t *task, timeUs_t currentTimeUs);
+#if defined(USE_SCHEDULER_RESUMABLE_TASKS)
+        bool updateResumableTask(task_t *task, timeUs_t currentTimeUs);
+#endif
+        task_t* realtimeQueueArray[SCHEDULER_QUEUE_CAPACITY]; // enabled TASK_PRIORITY_REALTIME tasks
+        int realtimeQueueSize = 0;
+        void realtimeQueueRemove(task_t *task);
+        volatile uint8_t signalsPending = 0;    // set by signalTask() since the start of the last pass
+        schedulerSleepFunc_t sleepFunc = NULL;
+        idleInfo_t idleInfo = {};
+#if defined(USE_SCHEDULER_EXECUTOR)
+        task_t *executorDispatch(timeUs_t currentTimeUs);
+        void executorCollect(void);
+        SchedulerExecutor *executor = NULL;
+        int inFlightCount = 0;
+        bool executorFull = false;      // the last submit was refused, cleared when a task comes back
+#endif
+#if defined(USE_SCHEDULER_PHASE_STAGGER)
+        void staggerTask(task_t *task, timeUs_t currentTimeUs);
+        timeDelta_t averageExecutionTimeUs(const task_t *task) const;
+#endif
+#if defined(USE_SCHEDULER_LOAD_ACCOUNTING)
+        void loadAccount(timeUs_t passStartUs, timeUs_t taskUs, bool dispatched, uint16_t waitingTasks, timeUs_t sleptUs);
+        loadWindow_t loadWindows[SCHEDULER_LOAD_WINDOWS] = {};
+        uint8_t loadWindowIndex = 0;
+        timeUs_t loadWindowStartUs = 0;
+        timeUs_t loadLastPassEndUs = 0;
+        timeUs_t loadCheckFuncUs = 0;   // checkFunc time in the pass so far
+#endif
+#if defined(USE_SCHEDULER_OVERLOAD_CONTROL)
+        void updateOverloadGovernor(timeUs_t currentTimeUs);
+        void setTaskPeriod(task_t *task, timeDelta_t nominalPeriodUs);
+        uint8_t overloadCeilingPercent = SCHEDULER_OVERLOAD_CEILING_PERCENT;
+        uint16_t overloadStretch = 256;         // 8.8 fixed point factor applied to stretchable periods
+        timeUs_t overloadBusyUs = 0;            // background execution time in the current window
+        timeUs_t overloadWindowStartUs = 0;
+        overloadInfo_t overloadInfo = {};
+#endif
+#if defined(USE_SCHEDULER_TASK_POOL)
+        taskHandle_t poolSchedule(void (*taskFunc)(timeUs_t currentTimeUs), timeDelta_t periodUs, timeDelta_t delayUs, int8_t priority, uint8_t taskFlags);
+        void poolReset(void);
+        void poolRelease(uint8_t slot);
+        task_t taskPool[SCHEDULER_TASK_POOL_SIZE] = {};
+        uint8_t poolGeneration[SCHEDULER_TASK_POOL_SIZE] = {};  // bumped on release, never 0
+        uint8_t poolFreeSlots[SCHEDULER_TASK_POOL_SIZE];    // stack of free slots
+        uint8_t poolFreeCount = 0;
+        taskPoolInfo_t poolInfo = {};
+#endif
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+        void logCapture(const char *fmt, va_list argp, bool newline);
+        bool logRead(uint16_t offset, void *data, uint16_t length);
+        uint8_t logBuffer[SCHEDULER_LOG_BUFFER_SIZE];
+        volatile uint16_t logHead = 0;  // free running, written by Log/Logln
+        volatile uint16_t logTail = 0;  // free running, written by logDrain
+        uint16_t logLineHead = 0;       // end of the records of the line Log is still adding to
+        uint16_t logLineRecords = 0;    // records between logHead and logLineHead
+        bool logDroppingLine = false;   // the line was cut short, drop up to its Logln
+        bool logFull = false;
+        char logLine[SCHEDULER_LOG_LINE_SIZE + 2];
+        uint16_t logLineLength = 0;
+        uint16_t logLinePos = 0;
+        logInfo_t logInfo = {};
+#endif
+#if defined(USE_SCHEDULER_TASK_CHAINS)
+        bool chainStart(task_t *task, timeUs_t currentTimeUs);
+        void chainComplete(task_t *task, bool triggered);
+        task_t *chainNext(task_t *task);
+        taskEdge_t taskEdges[SCHEDULER_MAX_TASK_EDGES];
+        uint8_t taskEdgeCount = 0;
+#endif
+#if defined(USE_SCHEDULER_SNAPSHOT)
+        void snapshotFlush(void);
+        uint8_t snapshotFrames[2][SCHEDULER_SNAPSHOT_SIZE] __attribute__((aligned(4)));
+        int8_t snapshotPendingIndex = -1;   // complete frame not sent yet
+        int8_t snapshotSendIndex = -1;      // frame being sent
+        uint16_t snapshotSendPos = 0;
+        uint16_t snapshotSendBytes = 0;
+        snapshotInfo_t snapshotInfo = {};
+#endif
+#if defined(USE_SCHEDULER_TRACE)
+        void traceRecord(uint8_t type, const task_t *task, timeUs_t timeUs, uint16_t arg);
+        traceEvent_t traceBuffer[SCHEDULER_TRACE_SIZE];
+        uint32_t traceHead = 0;             // free running, events recorded since the last reset
+        volatile bool traceEnabled = true;
+        bool traceStopOnMiss = false;
+        uint16_t traceStopCountdown = 0;    // events left before a stop after a deadline miss
+#endif
+#if defined(USE_SCHEDULER_DEADLINE_QUEUE)
+        task_t* taskHeapArray[SCHEDULER_QUEUE_CAPACITY];  // time-driven tasks, earliest nextDueAtUs first
+        int taskHeapSize = 0;
+        task_t* taskEventArray[SCHEDULER_QUEUE_CAPACITY]; // event-driven tasks, still polled every pass
+        int taskEventSize = 0;
+        bool heapContains(const task_t *task);
+        void heapSwap(int a, int b);
+        void heapSiftUp(int index);
+        void heapSiftDown(int index);
+        void heapInsert(task_t *task, timeUs_t currentTimeUs);
+        void heapRemove(task_t *task);
+        void heapUpdate(task_t *task);
+        void heapSelectDue(int index, timeUs_t currentTimeUs, task_t **selectedTask, uint32_t *selectedTaskRank, uint16_t *waitingTasks);
+#elif defined(USE_SCHEDULER_SPLIT_TASKS)
+        // Parallel to taskQueueArray, all the scan needs to pass over a task that is not due
+        timeUs_t taskQueueBasisUs[SCHEDULER_QUEUE_CAPACITY];     // period calculation basis
+        timeDelta_t taskQueuePeriodUs[SCHEDULER_QUEUE_CAPACITY]; // desiredPeriodUs, 0 for tasks looked at on every pass
+        void queueRenumber(int index);
+        void queueUpdateDue(task_t *task);
+#endif
+};
+
+/*
+ * Position of a task in the task table, pool slots follow the table
+ */
+inline int Scheduler::taskIndex(const task_t *task) const
+{
+#if defined(USE_SCHEDULER_TASK_POOL)
+    if (task >= taskPool && task < taskPool + SCHEDULER_TASK_POOL_SIZE) {
+        return taskCount + (task - taskPool);
+    }
+#endif
+    return task - taskTable;
+}
+
+inline taskState_t *Scheduler::taskState(task_t *task)
+{
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+    return &taskStates[taskIndex(task)];
+#else
+    return &task->state;
+#endif
+}
+
+inline const taskState_t *Scheduler::taskState(const task_t *task) const
+{
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+    return &taskStates[taskIndex(task)];
+#else
+    return &task->state;
+#endif
+}
+
+#if defined(USE_TASK_STATISTICS)
+inline taskStatistics_t *Scheduler::taskStatistics(task_t *task)
+{
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+    return &taskStatisticsTable[taskIndex(task)];
+#else
+    return &task->statistics;
+#endif
+}
+
+inline const taskStatistics_t *Scheduler::taskStatistics(const task_t *task) const
+{
+#if defined(USE_SCHEDULER_SPLIT_TASKS)
+    return &taskStatisticsTable[taskIndex(task)];
+#else
+    return &task->statistics;
+#endif
+}
+#endif
+
+#if defined(USE_SCHEDULER_TRACE)
+/*
+ * In the header so it inlines into the dispatch path: one atomic increment and
+ * an 8 byte store. Interrupts and executor threads may record concurrently,
+ * each gets its own slot.
+ */
+inline void Scheduler::traceRecord(uint8_t type, const task_t *task, timeUs_t timeUs, uint16_t arg)
+{
+    if (!traceEnabled) {
+        return;
+    }
+    traceEvent_t *event = &traceBuffer[__atomic_fetch_add(&traceHead, 1, __ATOMIC_RELAXED) & (SCHEDULER_TRACE_SIZE - 1)];
+    event->timeUs = timeUs;
+#if defined(USE_SCHEDULER_EXECUTOR)
+    // Spans of tasks running at once on different threads only nest per thread
+    const int thread = threadSlot();
+    event->type = type | ((thread < 0 ? TRACE_OTHER_THREAD : thread) << TRACE_THREAD_SHIFT);
+#else
+    event->type = type;
+#endif
+    event->taskIndex = task ? taskIndex(task) : TRACE_NO_TASK;
+    event->arg = arg;
+    // Stops a while after a deadline miss, see setTraceStopOnMiss(). Only the thread taking the count to 0 stops it
+    uint16_t countdown = __atomic_load_n(&traceStopCountdown, __ATOMIC_RELAXED);
+    while (countdown > 0) {
+        if (__atomic_compare_exchange_n(&traceStopCountdown, &countdown, (uint16_t)(countdown - 1), true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            if (countdown == 1) {
+                traceEnabled = false;
+            }
+            break;
+        }
+    }
+}
+#endif
@@ -0,0 +1,383 @@
+#include "Scheduler.h"
+#include <stdio.h>
+#include <string.h>
+
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+
+/*
+ * Deferred logging. Log/Logln store the format string pointer and the raw
+ * arguments in a byte ring, one record per call:
+ *
+ *   const char *fmt | uint8_t argBytes, bit 7 set for Logln | packed args
+ *
+ * Every argument is stored at its promoted width, the drain walks the format
+ * string again to unpack them. Records of a line only become visible to the
+ * drain with its Logln, a line that does not fit is dropped as a whole.
+ *
+ * The format string and any %s argument must stay valid until the record is
+ * drained, string literals and task names do. The ring has a single producer
+ * (task code) and a single consumer (logDrain), so Log must not be called
+ * from an interrupt. Tasks on executor threads are serialized by its lock.
+ */
+
+static_assert(SCHEDULER_LOG_LINE_SIZE + 2 <= UINT16_MAX, "SCHEDULER_LOG_LINE_SIZE must fit the uint16_t line position");
+
+#define LOG_RECORD_NEWLINE 0x80
+#define LOG_ARGS_SIZE (SCHEDULER_LOG_MAX_ARGS * 8)  // no argument is wider than long long or double
+#define LOG_SPEC_SIZE 16
+#define LOG_SPEC_TAIL 4     // room kept for "ll", the conversion and the NUL
+
+static_assert(LOG_ARGS_SIZE < LOG_RECORD_NEWLINE, "SCHEDULER_LOG_MAX_ARGS arguments must fit the record header");
+
+static const char logSpecFlags[] = "-+ #0123456789.*";
+
+static uint16_t logUsedBytes(uint16_t head, uint16_t tail)
+{
+    return (uint16_t)(head - tail);
+}
+
+template<typename T> static void logPack(uint8_t *args, uint8_t *argBytes, T value)
+{
+    memcpy(args + *argBytes, &value, sizeof(value));
+    *argBytes += sizeof(value);
+}
+
+template<typename T> static bool logUnpack(const uint8_t *args, uint8_t argBytes, uint8_t *argPos, T *value)
+{
+    if (*argPos + sizeof(*value) > argBytes) {
+        return false;
+    }
+    memcpy(value, args + *argPos, sizeof(*value));
+    *argPos += sizeof(*value);
+    return true;
+}
+
+/*
+ * Walks the format string and pulls every argument off the va_list, using the
+ * conversion to pick the promoted type. Returns the number of bytes stored.
+ */
+static uint8_t logCaptureArgs(const char *fmt, va_list argp, uint8_t *args)
+{
+    uint8_t argCount = 0;
+    uint8_t argBytes = 0;
+    while (*fmt && argCount < SCHEDULER_LOG_MAX_ARGS) {
+        if (*fmt++ != '%') {
+            continue;
+        }
+        while (*fmt && strchr(logSpecFlags, *fmt)) {
+            if (*fmt == '*' && argCount < SCHEDULER_LOG_MAX_ARGS) {
+                logPack(args, &argBytes, va_arg(argp, int));
+                argCount++;
+            }
+            fmt++;
+        }
+        uint8_t longCount = 0;
+        while (*fmt == 'l' || *fmt == 'h') {
+            longCount += *fmt == 'l';
+            fmt++;
+        }
+        const char conversion = *fmt;
+        if (!conversion || argCount >= SCHEDULER_LOG_MAX_ARGS) {
+            break;
+        }
+        fmt++;
+        if (conversion == '%') {
+            continue;
+        }
+        switch (conversion) {
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            if (longCount > 1) {
+                logPack(args, &argBytes, va_arg(argp, unsigned long long));
+            } else if (longCount) {
+                logPack(args, &argBytes, va_arg(argp, unsigned long));
+            } else {
+                logPack(args, &argBytes, va_arg(argp, unsigned int));
+            }
+            break;
+        case 's':
+        case 'p':
+            logPack(args, &argBytes, va_arg(argp, const void *));
+            break;
+        case 'f':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+            logPack(args, &argBytes, va_arg(argp, double));
+            break;
+        default:
+            if (longCount > 1) {
+                logPack(args, &argBytes, va_arg(argp, long long));
+            } else if (longCount) {
+                logPack(args, &argBytes, va_arg(argp, long));
+            } else {
+                logPack(args, &argBytes, va_arg(argp, int));
+            }
+            break;
+        }
+        argCount++;
+    }
+    return argBytes;
+}
+
+/*
+ * Formats one record, one conversion at a time since the arguments can not be
+ * turned back into a va_list. A '*' width is written into the spec as a number,
+ * a spec that does not fit into LOG_SPEC_SIZE loses its last flag characters.
+ */
+static int logFormat(char *out, int size, const char *fmt, const uint8_t *args, uint8_t argBytes)
+{
+    int length = 0;
+    uint8_t argPos = 0;
+    while (*fmt && length < size - 1) {
+        if (*fmt != '%') {
+            out[length++] = *fmt++;
+            continue;
+        }
+        char spec[LOG_SPEC_SIZE];
+        int specLength = 0;
+        spec[specLength++] = *fmt++;
+        while (*fmt && strchr(logSpecFlags, *fmt)) {
+            const int specRoom = LOG_SPEC_SIZE - LOG_SPEC_TAIL - specLength;
+            int width;
+            if (*fmt == '*') {
+                if (logUnpack(args, argBytes, &argPos, &width)) {
+                    const int written = snprintf(spec + specLength, specRoom + 1, "%d", width);
+                    specLength += MAX(0, MIN(written, specRoom));
+                }
+            } else if (specRoom > 0) {
+                spec[specLength++] = *fmt;
+            }
+            fmt++;
+        }
+        uint8_t longCount = 0;
+        while (*fmt == 'l' || *fmt == 'h') {
+            longCount += *fmt == 'l';
+            fmt++;
+        }
+        const char conversion = *fmt;
+        if (!conversion) {
+            break;
+        }
+        fmt++;
+        if (conversion == '%') {
+            out[length++] = '%';
+            continue;
+        }
+        if (argPos >= argBytes) {
+            break;
+        }
+        longCount = MIN(longCount, (uint8_t)2);
+        for (uint8_t ii = 0; ii < longCount; ii++) {
+            spec[specLength++] = 'l';
+        }
+        spec[specLength++] = conversion;
+        spec[specLength] = '\0';
+
+        // Each case reads the argument at the width logCaptureArgs() stored it with
+        int written = 0;
+        unsigned long long ull;
+        unsigned long ul;
+        unsigned int u;
+        long long ll;
+        long l;
+        int i;
+        const void *p;
+        double d;
+        switch (conversion) {
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            if (longCount > 1 ? logUnpack(args, argBytes, &argPos, &ull) : longCount ? logUnpack(args, argBytes, &argPos, &ul) : logUnpack(args, argBytes, &argPos, &u)) {
+                written = longCount > 1 ? snprintf(out + length, size - length, spec, ull)
+                    : longCount ? snprintf(out + length, size - length, spec, ul)
+                    : snprintf(out + length, size - length, spec, u);
+            }
+            break;
+        case 's':
+            if (logUnpack(args, argBytes, &argPos, &p)) {
+                written = snprintf(out + length, size - length, spec, (const char *)p);
+            }
+            break;
+        case 'p':
+            if (logUnpack(args, argBytes, &argPos, &p)) {
+                written = snprintf(out + length, size - length, spec, p);
+            }
+            break;
+        case 'f':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+            if (logUnpack(args, argBytes, &argPos, &d)) {
+                written = snprintf(out + length, size - length, spec, d);
+            }
+            break;
+        default:
+            if (longCount > 1 ? logUnpack(args, argBytes, &argPos, &ll) : longCount ? logUnpack(args, argBytes, &argPos, &l) : logUnpack(args, argBytes, &argPos, &i)) {
+                written = longCount > 1 ? snprintf(out + length, size - length, spec, ll)
+                    : longCount ? snprintf(out + length, size - length, spec, l)
+                    : snprintf(out + length, size - length, spec, i);
+            }
+            break;
+        }
+        if (written > 0) {
+            length = MIN(length + written, size - 1);
+        }
+    }
+    out[length] = '\0';
+    return length;
+}
+
+void Scheduler::logCapture(const char *fmt, va_list argp, bool newline)
+{
+    SCHEDULER_LOCK();   // tasks on executor threads log too
+    if (logDroppingLine) {
+        // The start of this line was dropped, its remaining records go too
+        logInfo.droppedRecords++;
+        logDroppingLine = !newline;
+        return;
+    }
+    uint8_t args[LOG_ARGS_SIZE];
+    const uint8_t argBytes = logCaptureArgs(fmt, argp, args);
+    const uint16_t recordLength = sizeof(fmt) + 1 + argBytes;
+
+    // Records of an unfinished line sit between logHead and logLineHead, the drain doesn't see them yet
+    const uint16_t usedBytes = logUsedBytes(logLineHead, __atomic_load_n(&logTail, __ATOMIC_ACQUIRE));
+    if (usedBytes + recordLength > SCHEDULER_LOG_BUFFER_SIZE) {
+        logInfo.droppedRecords += 1 + logLineRecords;
+        logLineHead = logHead;
+        logLineRecords = 0;
+        logDroppingLine = !newline;
+        if (!logFull) {
+            logFull = true;
+            logInfo.overflowEvents++;
+        }
+        return;
+    }
+    logFull = false;
+
+    const uint8_t header = argBytes | (newline ? LOG_RECORD_NEWLINE : 0);
+    const uint8_t *parts[3] = { (const uint8_t *)&fmt, &header, args };
+    const uint16_t partLengths[3] = { sizeof(fmt), 1, argBytes };
+    uint16_t pos = logLineHead;
+    for (int part = 0; part < 3; part++) {
+        for (uint16_t ii = 0; ii < partLengths[part]; ii++) {
+            logBuffer[pos++ & (SCHEDULER_LOG_BUFFER_SIZE - 1)] = parts[part][ii];
+        }
+    }
+    logLineHead = pos;
+    logInfo.maxUsedBytes = MAX(logInfo.maxUsedBytes, (uint16_t)(usedBytes + recordLength));
+    if (!newline) {
+        logLineRecords++;
+        return;
+    }
+    __atomic_store_n(&logHead, pos, __ATOMIC_RELEASE);
+    logInfo.capturedRecords += 1 + logLineRecords;
+    logLineRecords = 0;
+}
+
+/*
+ * Copies length bytes starting offset bytes past the tail, false if they have not all been captured yet
+ */
+bool Scheduler::logRead(uint16_t offset, void *data, uint16_t length)
+{
+    const uint16_t tail = logTail;
+    if (logUsedBytes(__atomic_load_n(&logHead, __ATOMIC_ACQUIRE), tail) < offset + length) {
+        return false;
+    }
+    for (uint16_t ii = 0; ii < length; ii++) {
+        ((uint8_t *)data)[ii] = logBuffer[(uint16_t)(tail + offset + ii) & (SCHEDULER_LOG_BUFFER_SIZE - 1)];
+    }
+    return true;
+}
+
+/*
+ * Formats pending records and hands at most budgetBytes to the serial port,
+ * never more than it can take without blocking
+ */
+void Scheduler::logDrain(uint16_t budgetBytes)
+{
+#if defined(USE_SCHEDULER_SNAPSHOT)
+    if (snapshotSendIndex >= 0) {
+        return;     // a snapshot frame is half sent, lines must not land inside it
+    }
+#endif
+    while (budgetBytes > 0) {
+        if (logLinePos >= logLineLength) {
+            const char *fmt;
+            uint8_t header;
+            uint8_t args[LOG_ARGS_SIZE];
+            if (!logRead(0, &fmt, sizeof(fmt)) || !logRead(sizeof(fmt), &header, 1)) {
+                return;
+            }
+            const uint8_t argBytes = header & ~LOG_RECORD_NEWLINE;
+            if (argBytes > LOG_ARGS_SIZE || !logRead(sizeof(fmt) + 1, args, argBytes)) {
+                return;
+            }
+            __atomic_store_n(&logTail, (uint16_t)(logTail + sizeof(fmt) + 1 + argBytes), __ATOMIC_RELEASE);
+
+            int length = logFormat(logLine, SCHEDULER_LOG_LINE_SIZE, fmt, args, argBytes);
+            if (length >= SCHEDULER_LOG_LINE_SIZE - 1) {
+                logInfo.truncatedLines++;
+            }
+            if (header & LOG_RECORD_NEWLINE) {
+                logLine[length++] = '\r';
+                logLine[length++] = '\n';
+            }
+            logLineLength = length;
+            logLinePos = 0;
+            continue;
+        }
+        const int availableBytes = SerialDebug.availableForWrite();
+        if (availableBytes <= 0) {
+            return;
+        }
+        const uint16_t chunkBytes = MIN(MIN(budgetBytes, (uint16_t)availableBytes), (uint16_t)(logLineLength - logLinePos));
+        SerialDebug.write((const uint8_t *)logLine + logLinePos, chunkBytes);
+        logLinePos += chunkBytes;
+        budgetBytes -= chunkBytes;
+    }
+}
+
+/*
+ * Blocks until every captured record has been sent, finishing a half sent
+ * snapshot frame first. Gives up when the serial port has taken nothing for
+ * SCHEDULER_LOG_FLUSH_TIMEOUT_US, returns false if records are left.
+ */
+bool Scheduler::logFlush(void)
+{
+    timeUs_t progressAtUs = micros();
+    while (logLinePos < logLineLength || logUsedBytes(logHead, logTail) > 0) {
+        const uint16_t tail = logTail;
+        const uint16_t linePos = logLinePos;
+#if defined(USE_SCHEDULER_SNAPSHOT)
+        const uint16_t snapshotPos = snapshotSendPos;
+        if (snapshotSendIndex >= 0) {
+            streamSnapshot(SCHEDULER_SNAPSHOT_SIZE);
+        }
+        const bool snapshotProgress = snapshotSendPos != snapshotPos;
+#else
+        const bool snapshotProgress = false;
+#endif
+        logDrain(SCHEDULER_LOG_LINE_SIZE);
+        const timeUs_t currentTimeUs = micros();
+        if (logTail != tail || logLinePos != linePos || snapshotProgress) {
+            progressAtUs = currentTimeUs;
+        } else if (cmpTimeUs(currentTimeUs, progressAtUs) >= SCHEDULER_LOG_FLUSH_TIMEOUT_US) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Scheduler::getLogInfo(logInfo_t *logInfo)
+{
+    *logInfo = this->logInfo;
+}
+
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Scheduler.h"
+
+/*
+ * Lock-free single producer, single consumer mailbox for passing items
+ * between schedulers on different cores or threads. One task (or interrupt)
+ * pushes, one task on the receiving scheduler pops. A successful push signals
+ * the receiving task through signalTask(), so it can be declared with
+ * DEFINE_SIGNAL_TASK and drain the mailbox when it runs:
+ *
+ *   SchedulerMailbox<sample_t, 16> samples(schedulerCore1, TASK_FILTER);
+ *
+ *   void taskSensor(timeUs_t currentTimeUs) {      // on core 0
+ *       samples.push(readSensor());
+ *   }
+ *
+ *   void taskFilter(timeUs_t currentTimeUs) {      // on core 1
+ *       sample_t sample;
+ *       while (samples.pop(&sample)) {
+ *           filter(sample);
+ *       }
+ *   }
+ *
+ * Size must be a power of two, head and tail run free and are only ever
+ * written by one side each.
+ */
+template <typename T, uint16_t Size>
+class SchedulerMailbox
+{
+    static_assert(Size > 0 && (Size & (Size - 1)) == 0, "SchedulerMailbox size must be a power of two");
+
+    public:
+        SchedulerMailbox(Scheduler &consumer, taskId_e consumerTaskId)
+            : consumer(&consumer), consumerTaskId(consumerTaskId) {}
+        SchedulerMailbox() : consumer(NULL), consumerTaskId(TASK_NONE) {}
+
+        // Producer side, returns false and counts a drop when the mailbox is full
+        bool push(const T &item)
+        {
+            const uint16_t head = this->head;
+            if ((uint16_t)(head - __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) >= Size) {
+                droppedItems++;
+                return false;
+            }
+            items[head & (Size - 1)] = item;
+            __atomic_store_n(&this->head, (uint16_t)(head + 1), __ATOMIC_RELEASE);
+            if (consumer) {
+                consumer->signalTask(consumerTaskId);
+            }
+            return true;
+        }
+
+        // Consumer side
+        bool pop(T *item)
+        {
+            const uint16_t tail = this->tail;
+            if (tail == __atomic_load_n(&head, __ATOMIC_ACQUIRE)) {
+                return false;
+            }
+            *item = items[tail & (Size - 1)];
+            __atomic_store_n(&this->tail, (uint16_t)(tail + 1), __ATOMIC_RELEASE);
+            return true;
+        }
+
+        uint16_t count(void) const
+        {
+            return (uint16_t)(__atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+        }
+
+        uint32_t getDroppedItems(void) const
+        {
+            return droppedItems;
+        }
+
+    private:
+        Scheduler *consumer;
+        taskId_e consumerTaskId;
+        T items[Size];
+        volatile uint16_t head = 0;     // written by the producer
+        volatile uint16_t tail = 0;     // written by the consumer
+        uint32_t droppedItems = 0;      // producer side
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Scheduler.h"
+
+/*
+ * Dispatch policies, the rule that picks one of the waiting background tasks.
+ * Realtime tasks always run first in earliest deadline first order, a policy
+ * only ranks the rest. Scheduler uses the policy named by SCHEDULER_POLICY,
+ * StaticScheduler takes it as a template argument (see BasicStaticScheduler).
+ *
+ * rank() is given the state of a waiting task and returns a value that is
+ * higher for the task that should run first, 0 for a task that is not waiting
+ * (dynamicPriority 0). All members are static and inline, so the selection
+ * loop is the same code as before for the default aging policy.
+ *
+ * deadlineUs is only worked out for policies with usesDeadline set. For a
+ * time-driven task it is the end of the period it is due in, for an
+ * event-driven task a period after it was signalled. TASK_PRIORITY_IDLE tasks
+ * run only when nothing else waits, whatever the policy.
+ */
+
+// Dynamic priority aging, staticPriority times the number of periods waited. Starvation free.
+struct SchedulerPolicyAging
+{
+    static const bool usesDeadline = false;
+
+    static inline uint32_t rank(uint16_t dynamicPriority, int8_t staticPriority, timeDelta_t periodUs, timeUs_t deadlineUs, timeUs_t currentTimeUs)
+    {
+        (void)staticPriority;
+        (void)periodUs;
+        (void)deadlineUs;
+        (void)currentTimeUs;
+        return dynamicPriority;
+    }
+};
+
+// Earliest deadline first, the task with the least slack wins. Meets every deadline up to 100% load.
+struct SchedulerPolicyEdf
+{
+    static const bool usesDeadline = true;
+
+    static inline uint32_t rank(uint16_t dynamicPriority, int8_t staticPriority, timeDelta_t periodUs, timeUs_t deadlineUs, timeUs_t currentTimeUs)
+    {
+        (void)periodUs;
+        if (dynamicPriority == 0 || staticPriority == TASK_PRIORITY_IDLE) {
+            return dynamicPriority > 0;
+        }
+        // 2 for a deadline INT32_MAX away, growing as the slack shrinks and turns negative
+        return (uint32_t)MIN((int64_t)UINT32_MAX, (int64_t)INT32_MAX + 2 - cmpTimeUs(deadlineUs, currentTimeUs));
+    }
+};
+
+// Rate monotonic, fixed priorities by period, the shortest period wins. Long period tasks can starve.
+struct SchedulerPolicyRateMonotonic
+{
+    static const bool usesDeadline = false;
+
+    static inline uint32_t rank(uint16_t dynamicPriority, int8_t staticPriority, timeDelta_t periodUs, timeUs_t deadlineUs, timeUs_t currentTimeUs)
+    {
+        (void)deadlineUs;
+        (void)currentTimeUs;
+        if (dynamicPriority == 0 || staticPriority == TASK_PRIORITY_IDLE) {
+            return dynamicPriority > 0;
+        }
+        // Periods up to 16.7 s in the upper 24 bits, equal periods are ordered by static priority
+        return (0x1000000 - (uint32_t)MAX(1, MIN(periodUs, 0xFFFFFF))) << 8 | (uint8_t)staticPriority;
+    }
+};
+
+typedef SCHEDULER_POLICY SchedulerPolicy;
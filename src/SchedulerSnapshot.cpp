@@ -0,0 +1,188 @@
+#include "Scheduler.h"
+#include <stddef.h>
+#include <string.h>
+
+#if defined(USE_SCHEDULER_SNAPSHOT)
+
+/*
+ * Statistics snapshot. takeSnapshot() copies the statistics of every enabled
+ * task into one of two frame buffers in a single pass under the scheduler
+ * lock, and resets the max values in that same pass, so no run falls between
+ * the copy and the reset. streamSnapshot() sends the newest complete frame a
+ * few bytes at a time while the next one is taken into the other buffer. A
+ * frame that was not started yet is replaced by a newer one. Layout, all
+ * fields little-endian:
+ *
+ *   snapshotHeader_t | taskRecordCount snapshotTask_t | their task names, NUL terminated
+ *
+ * extras/tools/snapshot2table.py finds frames in a serial capture by their
+ * "SSNP" magic and checksum and prints them as the printTasks() table.
+ */
+
+static_assert(sizeof(snapshotHeader_t) == 36, "snapshotHeader_t must not be padded");
+static_assert(sizeof(snapshotTask_t) == 40, "snapshotTask_t must not be padded");
+
+static const char *snapshotTaskName(const task_t *task)
+{
+    return task->taskName ? task->taskName : "";
+}
+
+/*
+ * Builds a frame of the enabled tasks, returns its length in bytes
+ */
+uint16_t Scheduler::takeSnapshot(bool resetMax)
+{
+    SCHEDULER_LOCK();
+    const int8_t frameIndex = snapshotSendIndex == 0 ? 1 : 0;
+    if (snapshotPendingIndex == frameIndex) {
+        snapshotInfo.replacedFrames++;
+        snapshotPendingIndex = -1;
+    }
+    uint8_t *frame = snapshotFrames[frameIndex];
+
+    snapshotHeader_t header = {};
+    memcpy(header.magic, "SSNP", sizeof(header.magic));
+    header.version = SNAPSHOT_FRAME_VERSION;
+    header.flags = resetMax ? SNAPSHOT_FLAG_MAX_RESET : 0;
+    header.taskRecordSize = sizeof(snapshotTask_t);
+    header.sequence = snapshotInfo.takenFrames++;
+    header.timeUs = micros();
+
+    // Work out how many tasks fit before anything is copied
+    uint16_t frameBytes = sizeof(snapshotHeader_t);
+    for (int taskId = 0; taskId < taskCount; taskId++) {
+        const task_t *task = getTask(taskId);
+        if (!taskState(task)->isQueued) {
+            continue;
+        }
+        const uint16_t recordBytes = sizeof(snapshotTask_t) + strlen(snapshotTaskName(task)) + 1;
+        if (frameBytes + recordBytes > SCHEDULER_SNAPSHOT_SIZE || header.taskRecordCount == UINT8_MAX) {
+            header.flags |= SNAPSHOT_FLAG_TRUNCATED;
+            snapshotInfo.truncatedFrames++;
+            break;
+        }
+        frameBytes += recordBytes;
+        header.taskRecordCount++;
+    }
+    header.frameBytes = frameBytes;
+
+    cfCheckFuncInfo_t checkFuncInfo;
+    getCheckFuncInfo(&checkFuncInfo);
+    header.checkFuncMaxExecutionTimeUs = checkFuncInfo.maxExecutionTimeUs;
+    header.checkFuncAverageExecutionTimeUs = checkFuncInfo.averageExecutionTimeUs;
+    header.checkFuncTotalExecutionTimeUs = checkFuncInfo.totalExecutionTimeUs;
+    header.averageSystemLoadPercent = averageSystemLoadPercent;
+#if defined(USE_SCHEDULER_LOAD_ACCOUNTING)
+    loadInfo_t loadInfo;
+    getLoadInfo(&loadInfo);
+    header.flags |= SNAPSHOT_FLAG_LOAD_ACCOUNTING;
+    header.cpuLoadPercent = loadInfo.cpuLoadPercent;
+    header.overheadPercent = loadInfo.overheadPercent;
+#endif
+    if (resetMax) {
+        schedulerResetCheckFunctionMaxExecutionTime();
+    }
+
+    uint8_t *record = frame + sizeof(snapshotHeader_t);
+    char *name = (char *)record + header.taskRecordCount * sizeof(snapshotTask_t);
+    for (int taskId = 0, recordCount = 0; taskId < taskCount && recordCount < header.taskRecordCount; taskId++) {
+        const task_t *task = getTask(taskId);
+        const taskState_t *state = taskState(task);
+        if (!state->isQueued) {
+            continue;
+        }
+        const taskStatistics_t *stats = taskStatistics(task);
+        snapshotTask_t taskRecord;
+        taskRecord.taskId = taskId;
+        taskRecord.staticPriority = task->staticPriority;
+        taskRecord.taskFlags = task->taskFlags;
+        taskRecord.desiredPeriodUs = state->desiredPeriodUs;
+        taskRecord.maxExecutionTimeUs = stats->maxExecutionTimeUs;
+        taskRecord.averageExecutionTimeUs = stats->movingSumExecutionTimeUs / TASK_STATS_MOVING_SUM_COUNT;
+        taskRecord.averageDeltaTimeUs = stats->movingSumDeltaTimeUs / TASK_STATS_MOVING_SUM_COUNT;
+        taskRecord.totalExecutionTimeUs = stats->totalExecutionTimeUs;
+        taskRecord.latestDeltaTimeUs = state->taskLatestDeltaTimeUs;
+        taskRecord.maxSignalLatencyUs = stats->maxSignalLatencyUs;
+        taskRecord.realtimeLateCount = stats->realtimeLateCount;
+        taskRecord.maxRealtimeLatenessUs = stats->maxRealtimeLatenessUs;
+        memcpy(record, &taskRecord, sizeof(taskRecord));
+        record += sizeof(taskRecord);
+
+        const char *taskName = snapshotTaskName(task);
+        const size_t nameBytes = strlen(taskName) + 1;
+        memcpy(name, taskName, nameBytes);
+        name += nameBytes;
+        recordCount++;
+
+        if (resetMax) {
+            schedulerResetTaskMaxExecutionTime((taskId_e)taskId);
+        }
+    }
+
+    memcpy(frame, &header, sizeof(header));
+    for (uint16_t ii = 0; ii < frameBytes; ii++) {
+        header.checksum += frame[ii];
+    }
+    memcpy(frame, &header, sizeof(header));
+
+    snapshotPendingIndex = frameIndex;
+    snapshotInfo.maxFrameBytes = MAX(snapshotInfo.maxFrameBytes, frameBytes);
+    return frameBytes;
+}
+
+/*
+ * Hands at most budgetBytes of the pending frame to the serial port, never
+ * more than it can take without blocking. Meant to be called from a low
+ * priority task, returns true while a frame is still waiting to be sent.
+ */
+bool Scheduler::streamSnapshot(uint16_t budgetBytes)
+{
+    SCHEDULER_LOCK();
+#if defined(USE_SCHEDULER_DEFERRED_LOG)
+    if (logLinePos < logLineLength) {
+        return true;    // the log line on the port goes out first
+    }
+#endif
+    if (snapshotSendIndex < 0) {
+        if (snapshotPendingIndex < 0) {
+            return false;
+        }
+        snapshotSendIndex = snapshotPendingIndex;
+        snapshotPendingIndex = -1;
+        snapshotSendPos = 0;
+        memcpy(&snapshotSendBytes, snapshotFrames[snapshotSendIndex] + offsetof(snapshotHeader_t, frameBytes), sizeof(snapshotSendBytes));
+    }
+    while (budgetBytes > 0 && snapshotSendPos < snapshotSendBytes) {
+        const int availableBytes = SerialDebug.availableForWrite();
+        if (availableBytes <= 0) {
+            break;
+        }
+        const uint16_t chunkBytes = MIN(MIN(budgetBytes, (uint16_t)availableBytes), (uint16_t)(snapshotSendBytes - snapshotSendPos));
+        SerialDebug.write(snapshotFrames[snapshotSendIndex] + snapshotSendPos, chunkBytes);
+        snapshotSendPos += chunkBytes;
+        budgetBytes -= chunkBytes;
+    }
+    if (snapshotSendPos >= snapshotSendBytes) {
+        snapshotSendIndex = -1;
+        snapshotInfo.sentFrames++;
+    }
+    return snapshotSendIndex >= 0 || snapshotPendingIndex >= 0;
+}
+
+/*
+ * Blocks until a half sent frame is out, so text written to the port next
+ * does not land inside it
+ */
+void Scheduler::snapshotFlush(void)
+{
+    while (snapshotSendIndex >= 0) {
+        streamSnapshot(SCHEDULER_SNAPSHOT_SIZE);
+    }
+}
+
+void Scheduler::getSnapshotInfo(snapshotInfo_t *snapshotInfo)
+{
+    *snapshotInfo = this->snapshotInfo;
+}
+
+#endif
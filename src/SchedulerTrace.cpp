@@ -0,0 +1,101 @@
+#include "Scheduler.h"
+#include <string.h>
+
+#if defined(USE_SCHEDULER_TRACE)
+
+/*
+ * Trace recorder. traceRecord() (Scheduler.h) overwrites the oldest event once
+ * the ring is full, so it always holds the newest SCHEDULER_TRACE_SIZE events.
+ * dumpTrace() writes them as one binary blob, all fields little-endian:
+ *
+ *   "STRC" | uint8_t version | uint8_t sizeof(traceEvent_t) | uint16_t nameCount | uint16_t eventCount
+ *   nameCount task names, NUL terminated, indexed by traceEvent_t.taskIndex
+ *   eventCount traceEvent_t, oldest first
+ *
+ * The upper 4 bits of traceEvent_t.type tell the threads apart, 0 on builds
+ * without USE_SCHEDULER_EXECUTOR. With one, 0 is normally the thread calling
+ * run_scheduler() and the workers follow in the order they ran their first task.
+ *
+ * extras/tools/trace2json.py finds the blob in a serial capture and turns it
+ * into Chrome trace / Perfetto JSON.
+ */
+
+void Scheduler::setTraceEnabled(bool enabled)
+{
+    __atomic_store_n(&traceStopCountdown, 0, __ATOMIC_RELAXED);
+    traceEnabled = enabled;
+}
+
+/*
+ * Freezes the trace a quarter ring after a realtime deadline miss, so the
+ * events leading up to it are kept
+ */
+void Scheduler::setTraceStopOnMiss(bool enabled)
+{
+    traceStopOnMiss = enabled;
+}
+
+void Scheduler::resetTrace(void)
+{
+    __atomic_store_n(&traceStopCountdown, 0, __ATOMIC_RELAXED);
+    traceHead = 0;
+    traceEnabled = true;
+}
+
+/*
+ * Copies the newest events into events[], oldest first. Stop the trace first
+ * for a consistent copy, otherwise the oldest events may already be overwritten.
+ */
+uint16_t Scheduler::getTraceEvents(traceEvent_t *events, uint16_t maxEvents)
+{
+    const uint32_t head = __atomic_load_n(&traceHead, __ATOMIC_ACQUIRE);
+    const uint16_t eventCount = MIN(MIN(head, (uint32_t)SCHEDULER_TRACE_SIZE), (uint32_t)maxEvents);
+    for (uint16_t ii = 0; ii < eventCount; ii++) {
+        events[ii] = traceBuffer[(head - eventCount + ii) & (SCHEDULER_TRACE_SIZE - 1)];
+    }
+    return eventCount;
+}
+
+void Scheduler::getTraceInfo(traceInfo_t *traceInfo)
+{
+    traceInfo->recordedEvents = traceHead;
+    traceInfo->enabled = traceEnabled;
+}
+
+/*
+ * Writes the trace blob to SerialDebug, blocking. Recording is paused meanwhile.
+ */
+void Scheduler::dumpTrace(void)
+{
+    const bool enabled = traceEnabled;
+    traceEnabled = false;
+
+    uint16_t nameCount = taskCount;
+#if defined(USE_SCHEDULER_TASK_POOL)
+    nameCount += SCHEDULER_TASK_POOL_SIZE;
+#endif
+    const uint32_t head = traceHead;
+    const uint16_t eventCount = MIN(head, (uint32_t)SCHEDULER_TRACE_SIZE);
+    const uint8_t header[10] = { 'S', 'T', 'R', 'C', TRACE_BLOB_VERSION, sizeof(traceEvent_t),
+        (uint8_t)nameCount, (uint8_t)(nameCount >> 8), (uint8_t)eventCount, (uint8_t)(eventCount >> 8) };
+    SerialDebug.write(header, sizeof(header));
+
+    for (uint16_t taskIndex = 0; taskIndex < nameCount; taskIndex++) {
+        const task_t *task = &taskTable[taskIndex];
+#if defined(USE_SCHEDULER_TASK_POOL)
+        if (taskIndex >= taskCount) {
+            task = &taskPool[taskIndex - taskCount];
+        }
+#endif
+        const char *name = task->taskName ? task->taskName : "";
+        SerialDebug.write((const uint8_t *)name, strlen(name) + 1);
+    }
+    for (uint16_t ii = 0; ii < eventCount; ii++) {
+        const traceEvent_t *event = &traceBuffer[(head - eventCount + ii) & (SCHEDULER_TRACE_SIZE - 1)];
+        SerialDebug.write((const uint8_t *)event, sizeof(*event));
+    }
+
+    traceEnabled = enabled;
+}
+
+#endif
@@ -0,0 +1,306 @@
+#pragma once
+
+#include "Scheduler.h"
+#include "SchedulerPolicy.h"
+
+/*
+ * Compile-time task table. The application lists its tasks as template
+ * arguments and the dispatch loop is generated for every task, so whether a
+ * task is event-driven or time-driven, realtime or background, and whether
+ * statistics are collected are all decided by the compiler instead of being
+ * tested on every pass. Task configuration lives in the code (flash), only
+ * the scheduling state is kept in RAM.
+ *
+ *   enum { STATIC_TASK_MAIN, STATIC_TASK_BLINK };  // ids follow the template argument order
+ *
+ *   StaticScheduler<true,
+ *       StaticTask<taskMain, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME>,
+ *       StaticTask<taskBlink, TASK_PERIOD_MS(1000), TASK_PRIORITY_HIGH>
+ *   > scheduler;
+ *
+ * Periods are template arguments and must be integral constants, use
+ * TASK_PERIOD_US/TASK_PERIOD_MS or cast TASK_PERIOD_HZ to timeDelta_t.
+ *
+ * StaticScheduler dispatches with SchedulerPolicy, BasicStaticScheduler takes
+ * the policy as its first argument:
+ *
+ *   BasicStaticScheduler<SchedulerPolicyEdf, true, StaticTask<...>, ...> scheduler;
+ */
+
+typedef void (*staticTaskFunc_t)(timeUs_t currentTimeUs);
+typedef bool (*staticCheckFunc_t)(timeUs_t currentTimeUs, timeDelta_t currentDeltaTimeUs);
+
+template<staticTaskFunc_t TaskFunc, timeDelta_t PeriodUs, int8_t Priority, staticCheckFunc_t CheckFunc = nullptr>
+struct StaticTask
+{
+    static constexpr timeDelta_t desiredPeriodUs = PeriodUs;
+    static constexpr int8_t staticPriority = Priority;
+    static constexpr bool isRealtime = Priority == TASK_PRIORITY_REALTIME;
+    static constexpr bool isEventDriven = CheckFunc != nullptr;
+
+    static inline void run(timeUs_t currentTimeUs) { TaskFunc(currentTimeUs); }
+    static inline bool check(timeUs_t currentTimeUs, timeDelta_t currentDeltaTimeUs) { return CheckFunc(currentTimeUs, currentDeltaTimeUs); }
+};
+
+typedef struct {
+    uint16_t dynamicPriority;
+    uint16_t taskAgeCycles;
+    timeDelta_t taskLatestDeltaTimeUs;
+    timeUs_t lastExecutedAtUs;
+    timeUs_t lastDesiredAt;         // only kept for policies ranking by deadline
+    timeUs_t lastSignaledAtUs;
+    bool enabled;
+} staticTaskState_t;
+
+typedef struct {
+    timeUs_t movingSumExecutionTimeUs;  // moving sum over TASK_STATS_MOVING_SUM_COUNT samples
+    timeUs_t movingSumDeltaTimeUs;
+    timeUs_t maxExecutionTimeUs;
+    timeUs_t totalExecutionTimeUs;
+} staticTaskStatistics_t;
+
+#if !defined(TASK_STATS_MOVING_SUM_COUNT)
+#define TASK_STATS_MOVING_SUM_COUNT 32
+#endif
+#define STATIC_TASK_AVERAGE_EXECUTE_FALLBACK_US 30
+#define STATIC_TASK_AVERAGE_EXECUTE_PADDING_US 5
+
+// Statistics storage, the disabled variant takes no RAM and every call is a no-op
+template<bool Statistics, int Count> struct StaticTaskStatistics
+{
+    staticTaskStatistics_t task[Count];
+
+    inline void record(int taskId, timeUs_t executionTimeUs, timeDelta_t deltaTimeUs)
+    {
+        staticTaskStatistics_t *stats = &task[taskId];
+        stats->movingSumExecutionTimeUs += executionTimeUs - stats->movingSumExecutionTimeUs / TASK_STATS_MOVING_SUM_COUNT;
+        stats->movingSumDeltaTimeUs += deltaTimeUs - stats->movingSumDeltaTimeUs / TASK_STATS_MOVING_SUM_COUNT;
+        stats->totalExecutionTimeUs += executionTimeUs;
+        stats->maxExecutionTimeUs = MAX(stats->maxExecutionTimeUs, executionTimeUs);
+    }
+    inline timeDelta_t requiredTimeUs(int taskId) const
+    {
+        return task[taskId].movingSumExecutionTimeUs / TASK_STATS_MOVING_SUM_COUNT + STATIC_TASK_AVERAGE_EXECUTE_PADDING_US;
+    }
+    inline void fill(int taskId, taskInfo_t *taskInfo) const
+    {
+        const staticTaskStatistics_t *stats = &task[taskId];
+        taskInfo->maxExecutionTimeUs = stats->maxExecutionTimeUs;
+        taskInfo->totalExecutionTimeUs = stats->totalExecutionTimeUs;
+        taskInfo->averageExecutionTimeUs = stats->movingSumExecutionTimeUs / TASK_STATS_MOVING_SUM_COUNT;
+        taskInfo->averageDeltaTimeUs = stats->movingSumDeltaTimeUs / TASK_STATS_MOVING_SUM_COUNT;
+    }
+    inline void resetMax(int taskId) { task[taskId].maxExecutionTimeUs = 0; }
+};
+
+template<int Count> struct StaticTaskStatistics<false, Count>
+{
+    inline void record(int, timeUs_t, timeDelta_t) {}
+    inline timeDelta_t requiredTimeUs(int) const { return STATIC_TASK_AVERAGE_EXECUTE_FALLBACK_US; }
+    inline void fill(int, taskInfo_t *) const {}
+    inline void resetMax(int) {}
+};
+
+template<int Index> struct StaticIndex {};
+
+template<int Index, typename... Tasks> struct StaticTaskAt;
+template<typename Task, typename... Rest> struct StaticTaskAt<0, Task, Rest...>
+{
+    typedef Task type;
+};
+template<int Index, typename Task, typename... Rest> struct StaticTaskAt<Index, Task, Rest...>
+{
+    typedef typename StaticTaskAt<Index - 1, Rest...>::type type;
+};
+
+template<typename Policy, bool Statistics, typename... Tasks>
+class BasicStaticScheduler
+{
+    public:
+        static const int taskCount = sizeof...(Tasks);
+
+        BasicStaticScheduler(const char * const *taskNames = NULL) : taskNames(taskNames)
+        {
+            memset(state, 0, sizeof(state));
+            memset(&statistics, 0, sizeof(statistics));
+        }
+
+        void setTaskEnabled(int taskId, bool enabled)
+        {
+            if (taskId >= 0 && taskId < taskCount) {
+                state[taskId].enabled = enabled;
+            }
+        }
+
+        void run_scheduler(void)
+        {
+            timeUs_t currentTimeUs = micros();
+            bool realtimeTaskRan = false;
+            bool realtimeRanThisPass[taskCount] = {};
+
+            // Realtime lane, every due realtime task runs once per pass in earliest deadline first order
+            for (;;) {
+                int realtimeTaskId = -1;
+                timeUs_t realtimeTaskDeadlineUs = 0;
+                findDueRealtimeTask(currentTimeUs, realtimeRanThisPass, &realtimeTaskId, &realtimeTaskDeadlineUs, StaticIndex<0>());
+                if (realtimeTaskId < 0) {
+                    break;
+                }
+                realtimeRanThisPass[realtimeTaskId] = true;
+                executeTask(realtimeTaskId, currentTimeUs, StaticIndex<0>());
+                currentTimeUs = micros();
+                realtimeTaskRan = true;
+            }
+
+            // The guard window is set by the soonest realtime deadline. When that task has just
+            // run its next deadline is a whole period away, so a background task may run regardless
+            timeDelta_t realtimeDelayUs = INT32_MAX;
+            bool soonestRealtimeRan = false;
+            findRealtimeDeadline(currentTimeUs, realtimeRanThisPass, &realtimeDelayUs, &soonestRealtimeRan, StaticIndex<0>());
+            const bool realtimeLaneClear = realtimeTaskRan && soonestRealtimeRan;
+
+            if (realtimeLaneClear || (realtimeDelayUs > GUARD_INTERVAL_US)) {
+                int selectedTaskId = -1;
+                uint32_t selectedTaskRank = 0;
+                selectTask(currentTimeUs, &selectedTaskId, &selectedTaskRank, StaticIndex<0>());
+
+                if (selectedTaskId >= 0) {
+                    // Add in the time spent so far in check functions and the scheduler logic
+                    const timeDelta_t taskRequiredTimeUs = statistics.requiredTimeUs(selectedTaskId) + cmpTimeUs(micros(), currentTimeUs);
+                    if (realtimeLaneClear || (taskRequiredTimeUs < realtimeDelayUs)) {
+                        executeTask(selectedTaskId, currentTimeUs, StaticIndex<0>());
+                    }
+                }
+            }
+        }
+
+        void getTaskInfo(int taskId, taskInfo_t *taskInfo)
+        {
+            memset(taskInfo, 0, sizeof(*taskInfo));
+            if (taskId < 0 || taskId >= taskCount) {
+                return;
+            }
+            taskInfo->taskName = taskNames ? taskNames[taskId] : NULL;
+            taskInfo->isEnabled = state[taskId].enabled;
+            taskInfo->latestDeltaTimeUs = state[taskId].taskLatestDeltaTimeUs;
+            getTaskConfig(taskId, taskInfo, StaticIndex<0>());
+            statistics.fill(taskId, taskInfo);
+        }
+
+        void schedulerResetTaskMaxExecutionTime(int taskId)
+        {
+            if (taskId >= 0 && taskId < taskCount) {
+                statistics.resetMax(taskId);
+            }
+        }
+
+    private:
+        staticTaskState_t state[taskCount];
+        StaticTaskStatistics<Statistics, taskCount> statistics;
+        const char * const *taskNames;
+
+        // Every helper below is unrolled over the task list, the overload taking
+        // StaticIndex<taskCount> ends the recursion
+
+        template<int Index> void findDueRealtimeTask(timeUs_t currentTimeUs, const bool *realtimeRanThisPass, int *realtimeTaskId, timeUs_t *realtimeTaskDeadlineUs, StaticIndex<Index>)
+        {
+            typedef typename StaticTaskAt<Index, Tasks...>::type Task;
+            if (Task::isRealtime && state[Index].enabled) {
+                const timeUs_t deadlineUs = state[Index].lastExecutedAtUs + Task::desiredPeriodUs;
+                if (cmpTimeUs(currentTimeUs, deadlineUs) >= 0 && !realtimeRanThisPass[Index]
+                    && (*realtimeTaskId < 0 || cmpTimeUs(deadlineUs, *realtimeTaskDeadlineUs) < 0)) {
+                    *realtimeTaskId = Index;
+                    *realtimeTaskDeadlineUs = deadlineUs;
+                }
+            }
+            findDueRealtimeTask(currentTimeUs, realtimeRanThisPass, realtimeTaskId, realtimeTaskDeadlineUs, StaticIndex<Index + 1>());
+        }
+        void findDueRealtimeTask(timeUs_t, const bool *, int *, timeUs_t *, StaticIndex<taskCount>) {}
+
+        template<int Index> void findRealtimeDeadline(timeUs_t currentTimeUs, const bool *realtimeRanThisPass, timeDelta_t *realtimeDelayUs, bool *soonestRealtimeRan, StaticIndex<Index>)
+        {
+            typedef typename StaticTaskAt<Index, Tasks...>::type Task;
+            if (Task::isRealtime && state[Index].enabled) {
+                const timeDelta_t delayUs = cmpTimeUs(state[Index].lastExecutedAtUs + Task::desiredPeriodUs, currentTimeUs);
+                if (delayUs < *realtimeDelayUs) {
+                    *realtimeDelayUs = delayUs;
+                    *soonestRealtimeRan = realtimeRanThisPass[Index];
+                }
+            }
+            findRealtimeDeadline(currentTimeUs, realtimeRanThisPass, realtimeDelayUs, soonestRealtimeRan, StaticIndex<Index + 1>());
+        }
+        void findRealtimeDeadline(timeUs_t, const bool *, timeDelta_t *, bool *, StaticIndex<taskCount>) {}
+
+        template<int Index> void selectTask(timeUs_t currentTimeUs, int *selectedTaskId, uint32_t *selectedTaskRank, StaticIndex<Index>)
+        {
+            typedef typename StaticTaskAt<Index, Tasks...>::type Task;
+            staticTaskState_t *task = &state[Index];
+            if (!Task::isRealtime && task->enabled) {
+                if (Task::isEventDriven) {
+                    if (task->dynamicPriority > 0) {
+                        task->taskAgeCycles = 1 + ((currentTimeUs - task->lastSignaledAtUs) / Task::desiredPeriodUs);
+                        task->dynamicPriority = 1 + Task::staticPriority * task->taskAgeCycles;
+                    } else if (Task::check(currentTimeUs, cmpTimeUs(currentTimeUs, task->lastExecutedAtUs))) {
+                        task->lastSignaledAtUs = currentTimeUs;
+                        task->taskAgeCycles = 1;
+                        task->dynamicPriority = 1 + Task::staticPriority;
+                    } else {
+                        task->taskAgeCycles = 0;
+                    }
+                } else {
+                    task->taskAgeCycles = ((currentTimeUs - task->lastExecutedAtUs) / Task::desiredPeriodUs);
+                    if (task->taskAgeCycles > 0) {
+                        task->dynamicPriority = 1 + Task::staticPriority * task->taskAgeCycles;
+                    }
+                }
+                const timeUs_t deadlineUs = !Policy::usesDeadline ? 0
+                    : Task::isEventDriven ? task->lastSignaledAtUs + Task::desiredPeriodUs : task->lastDesiredAt + 2 * Task::desiredPeriodUs;
+                const uint32_t rank = Policy::rank(task->dynamicPriority, Task::staticPriority, Task::desiredPeriodUs, deadlineUs, currentTimeUs);
+                if (rank > *selectedTaskRank) {
+                    *selectedTaskRank = rank;
+                    *selectedTaskId = Index;
+                }
+            }
+            selectTask(currentTimeUs, selectedTaskId, selectedTaskRank, StaticIndex<Index + 1>());
+        }
+        void selectTask(timeUs_t, int *, uint32_t *, StaticIndex<taskCount>) {}
+
+        template<int Index> void executeTask(int taskId, timeUs_t currentTimeUs, StaticIndex<Index>)
+        {
+            typedef typename StaticTaskAt<Index, Tasks...>::type Task;
+            if (taskId != Index) {
+                executeTask(taskId, currentTimeUs, StaticIndex<Index + 1>());
+                return;
+            }
+            staticTaskState_t *task = &state[Index];
+            task->taskLatestDeltaTimeUs = cmpTimeUs(currentTimeUs, task->lastExecutedAtUs);
+            task->lastExecutedAtUs = currentTimeUs;
+            if (Policy::usesDeadline) {
+                task->lastDesiredAt += (cmpTimeUs(currentTimeUs, task->lastDesiredAt) / Task::desiredPeriodUs) * Task::desiredPeriodUs;
+            }
+            task->dynamicPriority = 0;
+            if (Statistics) {
+                const timeUs_t currentTimeBeforeTaskCallUs = micros();
+                Task::run(currentTimeBeforeTaskCallUs);
+                statistics.record(Index, micros() - currentTimeBeforeTaskCallUs, task->taskLatestDeltaTimeUs);
+            } else {
+                Task::run(currentTimeUs);
+            }
+        }
+        void executeTask(int, timeUs_t, StaticIndex<taskCount>) {}
+
+        template<int Index> void getTaskConfig(int taskId, taskInfo_t *taskInfo, StaticIndex<Index>)
+        {
+            typedef typename StaticTaskAt<Index, Tasks...>::type Task;
+            if (taskId != Index) {
+                getTaskConfig(taskId, taskInfo, StaticIndex<Index + 1>());
+                return;
+            }
+            taskInfo->desiredPeriodUs = Task::desiredPeriodUs;
+            taskInfo->staticPriority = Task::staticPriority;
+        }
+        void getTaskConfig(int, taskInfo_t *, StaticIndex<taskCount>) {}
+};
+
+template<bool Statistics, typename... Tasks>
+using StaticScheduler = BasicStaticScheduler<SchedulerPolicy, Statistics, Tasks...>;